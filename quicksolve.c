@@ -1,49 +1,478 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <unistd.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <libgen.h>
 
 #include "src/integral.h"
 #include "src/integralmgr.h"
+#include "src/integralstream.h"
 #include "src/operand.h"
 #include "src/coefficient.h"
 #include "src/print.h"
 #include "src/pivotgraph.h"
 
 #define DEF_NUM_PROCESSORS 1
+#define DEF_FRONTENDS 1
 #define DEF_PREALLOC 1<<20
 #define DEF_MEMLIMIT 0
 #define DEF_BACKING "storage.dat#type=kch"
 #define DEF_FERCYCLE 0
 #define DEF_LIMITTERMINALS 0
+#define DEF_PREFETCH_DEPTH 0
+#define DEF_PREFETCH_LIMIT 1<<28
+#define DEF_PIVOTLIMIT 0
+#define DEF_CHECKPOINT 3600
+#define DEF_ZEROTEST 0
+#define DEF_WIDTH 1
+#define MANIFEST_HEADER "quicksolve checkpoint"
+
+#define APPEND_LITERAL( b,s ) qs_print_buffer_append( b,s,sizeof (s) - 1 )
 
 #define STR( X ) #X
 #define XSTR( X ) STR( X )
 
-const char const usage[ ]= "[-p <Symbolic threads>] [-n <Numeric threads>] [-k <Fermat cycle>] [-a <Identity limit>] [-m <Memory limit>] [-e <Elimination Mode>] [-t <Terminal Limit>] [-b <Backing DB>] [-q] [<Symbol><Assignment><Substitution>] ...]\n\n"
+const char const usage[ ]= "[-p <Symbolic threads>] [-n <Numeric threads>] [-x] [-z <Zero test primes>] [-j <Frontends>] [-o <Output order>] [-k <Fermat cycle>] [-a <Identity limit>] [-m <Memory limit>] [-g <Policy>] [-e <Elimination Mode>] [-s <Selection>] [-w <Width>] [-t <Terminal Limit>] [-d <Prefetch depth>] [-c <Prefetch limit>] [-l <Pivot limit>] [-r <Manifest> [-i <Checkpoint interval>]] [-b <Backing DB>] [-q] [<Symbol><Assignment><Substitution>] ...]\n\n"
 	"<Symbolic threads>: Number of evaluators in parallel calculation of symbolic expressions [Default " XSTR( DEF_NUM_PROCESSORS ) "]\n"
 	"<Numeric threads>: Number of evaluators in parallel calculation of numeric expressions [Default " XSTR( DEF_NUM_PROCESSORS ) "]\n"
-	"<Identity limit>: Upper bound on the number of identities in the system [Default " XSTR( DEF_PREALLOC ) "]\n"
+	"<Zero test primes>: If greater than 0, numeric coefficients are evaluated in-process modulo that many 63-bit primes, at most " XSTR( QS_MODULAR_MAX_PRIMES ) ", with random values for all symbols not substituted in the symbolic result. A nonzero coefficient of degree d is mistaken for zero with probability below (d/2^62)^<Zero test primes>, such that numerical zeroes are optimistically discarded unless -e is given [Default " XSTR( DEF_ZEROTEST ) "]\n"
+	"<Frontends>: Number of integrals solved concurrently. [Default " XSTR( DEF_FRONTENDS ) "]\n"
+	"<Output order>: Order in which solutions are printed once they are evaluated. Either of: order of (i)nput or of (c)ompletion [Default i]\n"
+	"<Identity limit>: Expected number of identities in the system for sizing of tables, which grow beyond it as needed [Default " XSTR( DEF_PREALLOC ) "]\n"
 	"<Memory limit>: Memory limit in bytes above which coefficients are written to disk backing space or 0 for no limit [Default " XSTR( DEF_MEMLIMIT )"]\n"
+	"<Policy>: Strategy of elimination, one of the policies listed below [Default cks]\n"
 	"<Elimination Mode>: How to deal with numerical zeroes. Either of: discard them (o)ptimistacally, (w)ait for the symbolic result, or (k)eep them [Default k]\n"
+	"<Selection>: Which of the edges found ready to eliminate first, if the policy chooses. Either of: the (f)irst one or the one of least (m)arkowitz-like cost in the size of its coefficient [Default f]\n"
+	"<Width>: Number of edges found ready at once which are relayed together, if the policy chooses. Those beyond the first are only taken if their identities are solved already, which are relayed eagerly [Default " XSTR( DEF_WIDTH ) "]\n"
 	"<Terminal limit>: Limit of number of evaluated coefficients to accumulate in the symbolic tree of operations [Default " XSTR( DEF_LIMITTERMINALS )"]\n"
+	"<Prefetch depth>: Depth up to which identities of upcoming eliminations are loaded ahead of time in the background or 0 to disable [Default " XSTR( DEF_PREFETCH_DEPTH )"]\n"
+	"<Prefetch limit>: Limit in bytes of coefficients loaded ahead of time but not yet used or 0 for no limit [Default " XSTR( DEF_PREFETCH_LIMIT )"]\n"
+	"<Pivot limit>: Number of identities to hold in memory above which the least recently used ones are written back to the solution databases or 0 for no limit [Default " XSTR( DEF_PIVOTLIMIT )"]\n"
+	"<Manifest>: File in which the progress is recorded at every checkpoint. If it exists, integrals which were completed according to it are skipped\n"
+	"<Checkpoint interval>: Seconds after which all identities are written back to the solution databases and the manifest is updated [Default " XSTR( DEF_CHECKPOINT )"]\n"
 	"<Backing DB>: Kyotocabinet formatted string indicating the disk backing space database [Default '" DEF_BACKING "']\n"
 	"<Symbol>: One of the symbols occurring in the databases. All symbols must be registered\n"
 	"<Assignment>: Either '=' for numeric assignment only or ':' to substitute the given value even in the symbolic result\n"
 	"<Substitution>: The value to be substituted for the associated symbol\n"
 	"<Fermat cycle>: If greater than 0, reinitializes the FERMAT backend every that many evaluations [Default " XSTR( DEF_FERCYCLE ) "]\n\n"
 	"Reads list of integrals from stdin and produces FORM fill statements for those integrals in terms of master integrals to stdout. All occurring symbols from the identity databases must be registered as positional arguments and can optionally be chosen to be replaced.\n"
+	"If -x is given, numeric coefficients are evaluated in-process on exact rationals instead of by FERMAT, which requires a rational numeric substitution for every symbol.\n"
 	"If -q is given, Quicksolve will not wait for finalization of each solution to print them but will only report that a solution has been formally obtained and may possibly still be evaluating.\n\n"
 	"For further documentation see the manual that came with Quicksolve";
 
 #include "src/policies/cks.c"
-
-struct CKSInfo info = { NULL,false,ELIMINATE_NONE };
+#include "src/policies/laporta.c"
+
+const struct Policy* const policies[ ]= { &cks_policy,&laporta_policy };
+
+enum Order {
+	ORDER_INPUT,
+	ORDER_COMPLETION
+};
+
+enum EmissionState {
+	EMISSION_SOLVING = 0,
+	EMISSION_REGISTERED,
+	EMISSION_EVALUATED,
+	EMISSION_PRINTED
+};
+
+/** Integral taken by a frontend
+ *
+ * Registered for printing once its solution has been formally obtained.
+ * The references to its coefficients keep the solution as it was then,
+ * such that the pivot is available to the frontends again meanwhile.
+ */
+struct Emission {
+	unsigned char state;
+	QsComponent id;
+
+	unsigned n_terminals;
+	QsTerminal* terminals; ///< References to the symbolic and numeric coefficients of the solution
+	QsComponent* heads; ///< Head of each pair of terminals
+	QsPrintBuffer text; ///< Formatted solution once evaluated
+};
+
+/** Distribution of integrals among frontends
+ *
+ * Integrals are solved concurrently by the frontends and printed by the
+ * writer as their coefficients are evaluated, either in the order of
+ * input or of completion. Everything is guarded by lock.
+ */
+struct Dispatch {
+	pthread_mutex_t lock;
+	pthread_cond_t change;
+
+	QsIntegralStream input;
+	QsIntegralMgr mgr;
+	QsPivotGraph graph;
+	QsPrintBuffer output;
+	bool quiet;
+	bool exhausted;
+	unsigned n_running; ///< Frontends which have not stopped
+	unsigned writer; ///< Owner of pivots while their solutions are registered
+	QsTerminalGroup waiter; ///< Coefficients the writer waits for
+
+	enum Order order;
+	unsigned first_turn; ///< Turn of the first emission
+	unsigned n_emissions;
+	unsigned allocated;
+	struct Emission* emissions; ///< By turn, up to the first not printed
+
+	const char* manifest;
+	unsigned checkpoint_interval;
+	time_t last_checkpoint;
+	bool checkpoint; ///< No integrals are taken until a checkpoint is made
+	unsigned completed; ///< Including those of a previous run
+};
+
+struct Dispatch dispatch = { PTHREAD_MUTEX_INITIALIZER,PTHREAD_COND_INITIALIZER };
+
+unsigned n_frontends = DEF_FRONTENDS;
+const struct Policy* policy;
+void** states; ///< Of the policy, by frontend
+volatile sig_atomic_t terminated = false;
 
 void signalled( int signum ) {
-	info.terminate = true;
+	terminated = true;
+
+	int j;
+	for( j = 0; j<n_frontends; j++ )
+		policy->terminate( states[ j ] );
+}
+
+/** Read the progress of a previous run
+ *
+ * @param Path of the manifest
+ *
+ * @return The number of integrals completed or 0 if there is no valid
+ * manifest
+ */
+static unsigned read_manifest( const char* path ) {
+	unsigned result = 0;
+	FILE* f = fopen( path,"r" );
+
+	if( f ) {
+		if( fscanf( f,MANIFEST_HEADER "\ncompleted %u\n",&result )!=1 ) {
+			fprintf( stderr,"Warning: Ignoring malformed manifest '%s'\n",path );
+			result = 0;
+		}
+
+		fclose( f );
+	}
+
+	return result;
+}
+
+/** Record progress
+ *
+ * Writes the manifest to a temporary file which then replaces the
+ * previous manifest, such that a crash leaves either the old or the new
+ * manifest intact.
+ *
+ * @param Path of the manifest
+ *
+ * @param Number of integrals completed
+ */
+static void write_manifest( const char* path,unsigned completed ) {
+	char* tmp;
+	if( asprintf( &tmp,"%s.tmp",path )<0 ) {
+		fprintf( stderr,"Warning: Could not write manifest '%s'\n",path );
+		return;
+	}
+
+	FILE* f = fopen( tmp,"w" );
+
+	if( !f ) {
+		fprintf( stderr,"Warning: Could not write manifest '%s'\n",tmp );
+		free( tmp );
+		return;
+	}
+
+	bool written = fprintf( f,MANIFEST_HEADER "\ncompleted %u\n",completed )>0;
+	written = !fflush( f )&& written;
+	written = !fsync( fileno( f ) )&& written;
+	written = !fclose( f )&& written;
+
+	if( !written || rename( tmp,path ) ) {
+		fprintf( stderr,"Warning: Could not replace manifest '%s'\n",path );
+		free( tmp );
+		return;
+	}
+
+	free( tmp );
+
+	/* The rename only survives a crash once the directory is synced */
+	char* dir_path = strdup( path );
+	int dir = open( dirname( dir_path ),O_RDONLY|O_DIRECTORY );
+
+	if( dir<0 || fsync( dir ) )
+		fprintf( stderr,"Warning: Could not sync the directory of manifest '%s'\n",path );
+
+	if( dir>=0 )
+		close( dir );
+
+	free( dir_path );
+}
+
+static void print_integral( QsPrintBuffer b,const QsIntegral i ) {
+	qs_print_buffer_commit( b,qs_integral_format( i,qs_print_buffer_reserve( b,qs_integral_format_size( i ) ) ) );
+}
+
+static void print_coefficient( QsPrintBuffer b,const QsCoefficient c ) {
+	qs_print_buffer_commit( b,qs_coefficient_format( c,qs_print_buffer_reserve( b,qs_coefficient_size( c ) ) ) );
+}
+
+static bool emission_finished( struct Emission* e ) {
+	int j;
+	for( j = 0; j<e->n_terminals; j++ )
+		if( !qs_operand_finished( (QsOperand)e->terminals[ j ] ) )
+			return false;
+
+	return true;
+}
+
+/** Format the solution of an integral
+ *
+ * All coefficients of the solution must have been evaluated. Drops the
+ * references to them, whenever the solution is printed.
+ */
+static void emission_format( struct Emission* e ) {
+	QsPrintBuffer text = e->text = qs_print_buffer_new( -1 );
+	QsIntegral target = qs_integral_mgr_peek( dispatch.mgr,e->id );
+
+	e->state = EMISSION_EVALUATED;
+
+	if( dispatch.quiet ) {
+		print_integral( text,target );
+		APPEND_LITERAL( text,"\n" );
+
+		return;
+	}
+
+	/* Without references, the integral had no identity to own */
+	if( !e->terminals )
+		return;
+
+	APPEND_LITERAL( text,"fill " );
+	print_integral( text,target );
+	APPEND_LITERAL( text," =" );
+
+	bool empty = true;
+
+	int j;
+	for( j = 0; 2*j<e->n_terminals; j++ ) {
+		if( e->heads[ j ]==e->id )
+			continue;
+
+		const QsCoefficient coefficient = qs_terminal_acquire( e->terminals[ 2*j ] );
+
+		if( !qs_coefficient_is_zero( coefficient ) ) {
+			APPEND_LITERAL( text,"\n + " );
+			print_integral( text,qs_integral_mgr_peek( dispatch.mgr,e->heads[ j ] ) );
+			APPEND_LITERAL( text," * (" );
+			print_coefficient( text,coefficient );
+			APPEND_LITERAL( text,")" );
+
+			empty = false;
+		}
+
+		qs_terminal_release( e->terminals[ 2*j ] );
+	}
+
+	if( empty )
+		APPEND_LITERAL( text,"\n0" );
+
+	APPEND_LITERAL( text,"\n;\n" );
+
+	for( j = 0; j<e->n_terminals; j++ )
+		qs_operand_unref( (QsOperand)e->terminals[ j ] );
+
+	free( e->terminals );
+	free( e->heads );
+	e->terminals = NULL;
+	e->heads = NULL;
+}
+
+/** Write back everything and record progress
+ *
+ * The dispatch must be held and all integrals taken must be printed.
+ */
+static void checkpoint( ) {
+	DBG_PRINT( "Checkpoint after %u integrals\n",0,dispatch.completed );
+
+	qs_pivot_graph_lock( dispatch.graph );
+	qs_pivot_graph_checkpoint( dispatch.graph );
+	qs_pivot_graph_unlock( dispatch.graph );
+
+	qs_integral_mgr_sync( dispatch.mgr );
+	write_manifest( dispatch.manifest,dispatch.completed );
+
+	dispatch.last_checkpoint = time( NULL );
+	dispatch.checkpoint = false;
+}
+
+static void* frontend( void* state ) {
+	pthread_mutex_lock( &dispatch.lock );
+
+	while( true ) {
+		while( dispatch.checkpoint && !terminated )
+			pthread_cond_wait( &dispatch.change,&dispatch.lock );
+
+		QsComponent id;
+		if( terminated || dispatch.exhausted ||( dispatch.exhausted = !qs_integral_stream_next( dispatch.input,dispatch.mgr,&id ) ) )
+			break;
+
+		if( dispatch.n_emissions==dispatch.allocated ) {
+			dispatch.allocated = dispatch.allocated?2*dispatch.allocated:n_frontends;
+			dispatch.emissions = realloc( dispatch.emissions,dispatch.allocated*sizeof (struct Emission) );
+		}
+
+		const unsigned turn = dispatch.first_turn + dispatch.n_emissions;
+		dispatch.emissions[ dispatch.n_emissions++ ]=( struct Emission ){ EMISSION_SOLVING,id,0,NULL,NULL,NULL };
+
+		pthread_mutex_unlock( &dispatch.lock );
+
+		qs_pivot_graph_lock( dispatch.graph );
+
+		policy->solve( state,id );
+
+		if( terminated ) {
+			qs_pivot_graph_unlock( dispatch.graph );
+			pthread_mutex_lock( &dispatch.lock );
+			break;
+		}
+
+		/* Hand the solution over to the writer and carry on while it is
+		 * being evaluated */
+		unsigned n_terminals = 0;
+		QsTerminal* terminals = NULL;
+		QsComponent* heads = NULL;
+		if( !dispatch.quiet && qs_pivot_graph_own( dispatch.graph,id,dispatch.writer,true ) ) {
+			n_terminals = qs_pivot_graph_terminals( dispatch.graph,id,&terminals,&heads );
+			qs_pivot_graph_disown( dispatch.graph,id );
+		}
+
+		qs_pivot_graph_unlock( dispatch.graph );
+
+		pthread_mutex_lock( &dispatch.lock );
+
+		/* The emissions may have moved meanwhile */
+		struct Emission* e = dispatch.emissions + turn - dispatch.first_turn;
+		e->state = EMISSION_REGISTERED;
+		e->n_terminals = n_terminals;
+		e->terminals = terminals;
+		e->heads = heads;
+
+		pthread_cond_broadcast( &dispatch.change );
+		qs_terminal_group_notify( dispatch.waiter );
+	}
+
+	dispatch.n_running--;
+	pthread_cond_broadcast( &dispatch.change );
+	pthread_mutex_unlock( &dispatch.lock );
+
+	return NULL;
+}
+
+/** Print solutions as they are evaluated
+ *
+ * Solutions are formatted as soon as they are evaluated, regardless of
+ * the order, such that the references to their coefficients are held no
+ * longer than necessary. Frontends end the wait for evaluations when
+ * they register further integrals. Output is written out before the
+ * writer waits, and otherwise only when the buffer fills.
+ */
+static void* writer( void* unused ) {
+	QsTerminalGroup waiter = dispatch.waiter;
+
+	pthread_mutex_lock( &dispatch.lock );
+
+	while( true ) {
+		bool progress = false;
+		bool pending = false;
+
+		int j;
+		for( j = 0; j<dispatch.n_emissions; j++ ) {
+			struct Emission* e = dispatch.emissions + j;
+
+			if( e->state==EMISSION_REGISTERED ) {
+				if( emission_finished( e ) ) {
+					emission_format( e );
+					progress = true;
+				} else
+					pending = true;
+			}
+
+			if( e->state==EMISSION_EVALUATED && !( dispatch.order==ORDER_INPUT && j>0 && dispatch.emissions[ j - 1 ].state!=EMISSION_PRINTED ) ) {
+				qs_print_buffer_transfer( dispatch.output,e->text );
+				qs_print_buffer_destroy( e->text );
+
+				e->state = EMISSION_PRINTED;
+				progress = true;
+			}
+		}
+
+		unsigned n_printed = 0;
+		while( n_printed<dispatch.n_emissions && dispatch.emissions[ n_printed ].state==EMISSION_PRINTED )
+			n_printed++;
+
+		memmove( dispatch.emissions,dispatch.emissions + n_printed,( dispatch.n_emissions - n_printed )*sizeof (struct Emission) );
+		dispatch.n_emissions -= n_printed;
+		dispatch.first_turn += n_printed;
+		dispatch.completed += n_printed;
+
+		if( dispatch.manifest && n_printed && difftime( time( NULL ),dispatch.last_checkpoint )>=dispatch.checkpoint_interval )
+			dispatch.checkpoint = true;
+
+		if( dispatch.checkpoint && !dispatch.n_emissions ) {
+			qs_print_buffer_flush( dispatch.output );
+			checkpoint( );
+			pthread_cond_broadcast( &dispatch.change );
+		}
+
+		if( progress )
+			continue;
+
+		qs_print_buffer_flush( dispatch.output );
+
+		if( pending ) {
+			/* Finished ones would end the wait right away */
+			for( j = 0; j<dispatch.n_emissions; j++ )
+				if( dispatch.emissions[ j ].state==EMISSION_REGISTERED ) {
+					int k;
+					for( k = 0; k<dispatch.emissions[ j ].n_terminals; k++ )
+						if( !qs_operand_finished( (QsOperand)dispatch.emissions[ j ].terminals[ k ] ) )
+							qs_terminal_group_push( waiter,dispatch.emissions[ j ].terminals[ k ] );
+				}
+
+			pthread_mutex_unlock( &dispatch.lock );
+			qs_terminal_group_wait( waiter );
+			pthread_mutex_lock( &dispatch.lock );
+
+			qs_terminal_group_clear( waiter );
+		} else if( dispatch.n_running )
+			pthread_cond_wait( &dispatch.change,&dispatch.lock );
+		else
+			break;
+	}
+
+	/* Solutions after an interrupted one are not printed */
+	int j;
+	for( j = 0; j<dispatch.n_emissions; j++ )
+		if( dispatch.emissions[ j ].state==EMISSION_EVALUATED )
+			qs_print_buffer_destroy( dispatch.emissions[ j ].text );
+
+	pthread_mutex_unlock( &dispatch.lock );
+
+	return NULL;
 }
 
 int main( const int argc,char* const argv[ ] ) {
@@ -55,14 +484,27 @@ int main( const int argc,char* const argv[ ] ) {
 	size_t limit_terminals = DEF_LIMITTERMINALS;
 	char* storage = DEF_BACKING;
 	unsigned fercycle = DEF_FERCYCLE;
+	unsigned prefetch_depth = DEF_PREFETCH_DEPTH;
+	size_t prefetch_limit = DEF_PREFETCH_LIMIT;
+	unsigned pivot_limit = DEF_PIVOTLIMIT;
+	char* manifest = NULL;
+	unsigned checkpoint_interval = DEF_CHECKPOINT;
 	bool quiet = false;
+	bool native = false;
+	unsigned zerotest = DEF_ZEROTEST;
+	enum Elimination elimination = ELIMINATE_NONE;
+	bool elimination_given = false;
+	char selection = 'f';
+	unsigned width = DEF_WIDTH;
+	enum Order order = ORDER_INPUT;
+	policy = policies[ 0 ];
 
 	bool help = false;
 	FILE* const infile = stdin;
 	FILE* const outfile = stdout;
 
 	int opt;
-	while( ( opt = getopt( argc,argv,"p:a:hqk:b:m:t:e:n:" ) )!=-1 ) {
+	while( ( opt = getopt( argc,argv,"p:a:hqxz:k:b:m:t:e:s:w:g:n:j:o:d:c:l:r:i:" ) )!=-1 ) {
 		char* endptr;
 		switch( opt ) {
 		case 'p':
@@ -73,6 +515,14 @@ int main( const int argc,char* const argv[ ] ) {
 			if( ( num_processors_numeric = strtol( optarg,&endptr,0 ) )<1 || *endptr!='\0' )
 				help = true;
 			break;
+		case 'j':
+			if( ( n_frontends = strtol( optarg,&endptr,0 ) )<1 || *endptr!='\0' )
+				help = true;
+			break;
+		case 'o':
+			if( optarg[ 0 ]=='c' )
+				order = ORDER_COMPLETION;
+			break;
 		case 'a':
 			if( ( prealloc = strtol( optarg,&endptr,0 ) )<0 || *endptr!='\0' )
 				help = true;
@@ -92,11 +542,49 @@ int main( const int argc,char* const argv[ ] ) {
 			if( ( limit_terminals = strtol( optarg,&endptr,0 ) )<0 || *endptr!='\0' )
 				help = true;
 			break;
+		case 'd':
+			if( ( prefetch_depth = strtol( optarg,&endptr,0 ) )<0 || *endptr!='\0' )
+				help = true;
+			break;
+		case 'c':
+			if( ( prefetch_limit = strtol( optarg,&endptr,0 ) )<0 || *endptr!='\0' )
+				help = true;
+			break;
+		case 'l':
+			if( ( pivot_limit = strtol( optarg,&endptr,0 ) )<0 || *endptr!='\0' )
+				help = true;
+			break;
+		case 'r':
+			manifest = optarg;
+			break;
+		case 'i':
+			if( ( checkpoint_interval = strtol( optarg,&endptr,0 ) )<0 || *endptr!='\0' )
+				help = true;
+			break;
 		case 'e':
+			elimination_given = true;
 			if( optarg[ 0 ]=='o' )
-				info.elimination = ELIMINATE_OPTIMISTIC;
+				elimination = ELIMINATE_OPTIMISTIC;
 			else if( optarg[ 0 ]=='w' )
-				info.elimination = ELIMINATE_WAIT;
+				elimination = ELIMINATE_WAIT;
+			break;
+		case 's':
+			selection = optarg[ 0 ];
+			if( selection!='f' && selection!='m' )
+				help = true;
+			break;
+		case 'w':
+			if( ( width = strtol( optarg,&endptr,0 ) )<1 || *endptr!='\0' )
+				help = true;
+			break;
+		case 'g':
+			policy = NULL;
+			for( unsigned k = 0; k<sizeof policies/sizeof policies[ 0 ]; k++ )
+				if( !strcmp( optarg,policies[ k ]->name ) )
+					policy = policies[ k ];
+
+			if( !policy )
+				help = true;
 			break;
 		case 'h':
 			help = true;
@@ -104,16 +592,31 @@ int main( const int argc,char* const argv[ ] ) {
 		case 'q':
 			quiet = true;
 			break;
+		case 'x':
+			native = true;
+			break;
+		case 'z':
+			if( ( zerotest = strtol( optarg,&endptr,0 ) )<0 || zerotest>QS_MODULAR_MAX_PRIMES || *endptr!='\0' )
+				help = true;
+			break;
 		}
 	}
 
 	QsDb storage_db = qs_db_new( storage,QS_DB_WRITE | QS_DB_CREATE );
 
+	/* Zeroes found modulo primes are reliable */
+	if( zerotest && !elimination_given )
+		elimination = ELIMINATE_OPTIMISTIC;
+
 	if( help || !storage_db ) {
-		printf( "%s %s\n",argv[ 0 ],usage );
+		printf( "%s %s\n\nPolicies:\n",argv[ 0 ],usage );
+		for( unsigned k = 0; k<sizeof policies/sizeof policies[ 0 ]; k++ )
+			printf( "%s: %s\n",policies[ k ]->name,policies[ k ]->description );
 		exit( EXIT_FAILURE );
 	}
 
+	states = calloc( n_frontends,sizeof (void*) );
+
 	// Reap fermat processes immediately
 	sigaction( SIGCHLD,&(struct sigaction){ .sa_handler = SIG_IGN,.sa_flags = SA_NOCLDWAIT },NULL );
 
@@ -146,7 +649,7 @@ int main( const int argc,char* const argv[ ] ) {
 /* Full replacement */
 			*separator_col = '\0';
 			value_numeric = separator_col + 1;
-			value = value;
+			value = value_numeric;
 		} else {
 /* Only numeric replacement */
 			*separator_equ = '\0';
@@ -155,12 +658,16 @@ int main( const int argc,char* const argv[ ] ) {
 		}
 
 		qs_evaluator_options_add( fermat_options,symbol,value );
-		qs_evaluator_options_add( fermat_options_numeric,symbol,value_numeric );
+		/* The zero test draws random values for symbols which remain in
+		 * the symbolic result */
+		qs_evaluator_options_add( fermat_options_numeric,symbol,zerotest?value:value_numeric );
 	}
 
 	qs_evaluator_options_add( fermat_options,"#",fercycle );
 	qs_evaluator_options_add( fermat_options,"!",FERMAT_BINARY );
 	qs_evaluator_options_add( fermat_options_numeric,"!",FERMAT_BINARY_NUMERIC );
+	qs_evaluator_options_add( fermat_options_numeric,"@",native );
+	qs_evaluator_options_add( fermat_options_numeric,"%",zerotest );
 
 #if QS_STATUS
 	QsAEF aef = qs_aef_new( limit_terminals,false );
@@ -170,7 +677,9 @@ int main( const int argc,char* const argv[ ] ) {
 	QsAEF aef_numeric = qs_aef_new( 0 );
 #endif
 
-	info.graph = qs_pivot_graph_new_with_size( aef,aef_numeric,mgr,(QsLoadFunction)qs_integral_mgr_load_expression,mgr,(QsSaveFunction)qs_integral_mgr_save_expression,storage_db,memlimit,prealloc );
+	QsPivotGraph graph = qs_pivot_graph_new_with_size( aef,aef_numeric,mgr,(QsLoadFunction)qs_integral_mgr_load_expression,(QsMetaFunction)qs_integral_mgr_load_meta,(QsFetchFunction)qs_integral_mgr_load_coefficient,mgr,(QsSaveFunction)qs_integral_mgr_save_expression,storage_db,memlimit,prealloc );
+	qs_pivot_graph_prefetch_start( graph,prefetch_depth,prefetch_limit );
+	qs_pivot_graph_limit_pivots( graph,pivot_limit );
 
 	for( j = 0; j<num_processors; j++ )
 		qs_aef_spawn( aef,fermat_options );
@@ -181,72 +690,80 @@ int main( const int argc,char* const argv[ ] ) {
 	qs_evaluator_options_destroy( fermat_options );
 	qs_evaluator_options_destroy( fermat_options_numeric );
 
-	ssize_t chars;
-	size_t N = 0;
-	char* buffer = NULL;
-	while( ( chars = getline( &buffer,&N,infile ) )!=-1 ) {
-		QsIntegral i = qs_integral_new_from_string( buffer );
-		if( i ) {
-			QsComponent id = qs_integral_mgr_manage( mgr,i );
-
-			cks_solve( &info,id );
-
-			if( info.terminate )
-				break;
-			
-			char* target;
-			qs_integral_print( qs_integral_mgr_peek( mgr,id ),&target );
-
-			if( quiet )
-				fprintf( outfile,"%s\n",target );
-			else {
-				struct QsReflist result = qs_pivot_graph_acquire( info.graph,id );
-
-				if( result.references ) {
-					fprintf( outfile,"fill %s =",target );
-
-					if( result.n_references>1 ) {
-						int j;
-						for( j = 0; j<result.n_references; j++ )
-							if( result.references[ j ].head!=id ) {
-								char* head,* coeff;
-
-								qs_integral_print( qs_integral_mgr_peek( mgr,result.references[ j ].head ),&head );
-								qs_coefficient_print( result.references[ j ].coefficient,&coeff );
-								fprintf( outfile,"\n + %s * (%s)",head,coeff );
-								free( coeff );
-								free( head );
-							}
-					} else
-						fprintf( outfile,"\n0" );
-
-					fprintf( outfile,"\n;\n" );
-					fflush( outfile );
-
-					free( result.references );
-
-					qs_pivot_graph_release( info.graph,id );
-				}
-			}
-
-			free( target );
-		} else
-			fprintf( stderr,"Warning: Could not parse '%s'\n",buffer );
+	QsIntegralStream input = qs_integral_stream_new( fileno( infile ) );
+	QsPrintBuffer output = qs_print_buffer_new( fileno( outfile ) );
+
+	unsigned n_malformed = qs_integral_stream_validate( input );
+	if( n_malformed )
+		fprintf( stderr,"Warning: %u malformed lines in input will be skipped\n",n_malformed );
+
+	QsComponent id;
+
+	/* Skip what a previous run completed, its solutions are found in the
+	 * solution databases */
+	unsigned completed = 0;
+	unsigned resumed = manifest?read_manifest( manifest ):0;
+	while( completed<resumed && qs_integral_stream_next( input,mgr,&id ) )
+		completed++;
+
+	if( resumed )
+		fprintf( stderr,"Resuming after %u completed integrals\n",completed );
+
+	dispatch.input = input;
+	dispatch.mgr = mgr;
+	dispatch.graph = graph;
+	dispatch.output = output;
+	dispatch.quiet = quiet;
+	dispatch.order = order;
+	dispatch.n_running = n_frontends;
+	dispatch.writer = n_frontends + 1;
+	dispatch.waiter = qs_terminal_group_new( 0 );
+	dispatch.manifest = manifest;
+	dispatch.checkpoint_interval = checkpoint_interval;
+	dispatch.last_checkpoint = time( NULL );
+	dispatch.completed = completed;
+
+	pthread_t output_thread;
+	pthread_create( &output_thread,NULL,writer,NULL );
+
+	pthread_t* frontends = malloc( n_frontends*sizeof (pthread_t) );
+
+	for( j = 0; j<n_frontends; j++ ) {
+		states[ j ]= policy->new( graph,j + 1,&( struct PolicyOptions ){ elimination,selection,width } );
+		pthread_create( frontends + j,NULL,frontend,states[ j ] );
 	}
 
-	free( buffer );
+	for( j = 0; j<n_frontends; j++ )
+		pthread_join( frontends[ j ],NULL );
+
+	free( frontends );
+
+	pthread_join( output_thread,NULL );
+	qs_terminal_group_destroy( dispatch.waiter );
+	free( dispatch.emissions );
+
+	qs_integral_stream_destroy( input );
+	qs_print_buffer_destroy( output );
 	
 	DBG_PRINT( "Solution done. Finalizing\n",0 );
 
-	qs_pivot_graph_destroy( info.graph );
+	qs_pivot_graph_destroy( graph );
 	qs_aef_destroy( aef );
 	qs_aef_destroy( aef_numeric );
 	qs_integral_mgr_destroy( mgr );
 
+	/* All databases are closed and thereby written at this point */
+	if( manifest )
+		write_manifest( manifest,dispatch.completed );
+
 	qs_db_destroy( storage_db );
 	
 	fclose( infile );
 	fclose( outfile );
+
+	for( j = 0; j<n_frontends; j++ )
+		policy->destroy( states[ j ] );
+	free( states );
 				
 	exit( EXIT_SUCCESS );
 }
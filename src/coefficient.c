@@ -8,11 +8,76 @@
 #include <sys/time.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <limits.h>
+#include <errno.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <time.h>
+#include <gmp.h>
 
 #include "coefficient.h"
 
+#define SUBSTITUTE_PREALLOC 16
+#define MODULAR_UNDEFINED UINT64_MAX
+
+/** Value of a native evaluation
+ *
+ * Either an exact rational or, if the evaluator works modulo primes, one
+ * residue per prime. A residue of MODULAR_UNDEFINED marks a division by
+ * a value which vanishes modulo that prime.
+ */
+struct Value {
+	mpq_t rational;
+	uint64_t residues[ QS_MODULAR_MAX_PRIMES ];
+};
+
+/** Value of a coefficient kept for native evaluators
+ *
+ * Results of native evaluations keep their value and other coefficients
+ * are given theirs when first parsed, such that no coefficient is parsed
+ * more than once by evaluators of the same domain. The value is not
+ * counted by qs_coefficient_size, which is that of the text.
+ */
+struct Native {
+	uint64_t domain; ///< Of the evaluators the value is valid for
+	unsigned n_primes;
+	struct Value value;
+};
+
 struct QsCoefficient {
 	char* text;
+	_Atomic( struct Native* ) native; ///< Set at most once, NULL until a native evaluator needs the value
+};
+
+/** Largest primes below 2^63
+ *
+ * Sums of two residues do not overflow and products are reduced by
+ * Barrett's method, see mulmod.
+ */
+static const uint64_t primes[ QS_MODULAR_MAX_PRIMES ]= {
+	9223372036854775783u,
+	9223372036854775643u,
+	9223372036854775549u,
+	9223372036854775507u,
+	9223372036854775433u,
+	9223372036854775421u,
+	9223372036854775417u,
+	9223372036854775399u
+};
+
+/** Barrett constants floor(2^126/p) of the primes
+ */
+static const uint64_t barrett[ QS_MODULAR_MAX_PRIMES ]= {
+	9223372036854775833u,
+	9223372036854775973u,
+	9223372036854776067u,
+	9223372036854776109u,
+	9223372036854776183u,
+	9223372036854776195u,
+	9223372036854776199u,
+	9223372036854776217u
 };
 
 struct QsEvaluator {
@@ -32,6 +97,12 @@ struct QsEvaluator {
 
 	QsCompoundDiscoverer discover;
 
+	bool native; ///< Evaluate in-process instead of by FERMAT
+	unsigned n_primes; ///< Number of primes modulo which is evaluated natively or 0 for exact rationals
+	uint64_t domain; ///< Shared by native evaluators which assign the same values to the symbols
+	struct Value* values; ///< Values of the symbols if native
+	struct Value result; ///< Result of the last native evaluation
+
 #ifdef DBG_EVALFILE
 	FILE* fermat_log;
 #endif
@@ -39,6 +110,9 @@ struct QsEvaluator {
 
 struct QsEvaluatorOptions {
 	unsigned cycle;
+	bool native;
+	unsigned n_primes;
+	uint64_t seed;
 	unsigned n_symbols;
 	char* binary;
 	char** symbols;
@@ -52,6 +126,9 @@ QsEvaluatorOptions qs_evaluator_options_new( ) {
 	QsEvaluatorOptions result = malloc( sizeof (struct QsEvaluatorOptions) );
 	result->n_symbols = 0;
 	result->cycle = 0;
+	result->native = false;
+	result->n_primes = 0;
+	result->seed = time( NULL )^getpid( );
 	result->binary = NULL;
 	result->symbols = malloc( 0 );
 	result->substitutions = malloc( 0 );
@@ -67,6 +144,11 @@ void qs_evaluator_options_add( QsEvaluatorOptions o,const char* first, ... ) {
 		o->cycle = va_arg( argp,unsigned );
 	} else if( !strcmp( name,"!" ) ) {
 		o->binary = strdup( va_arg( argp,char* ) );
+	} else if( !strcmp( name,"@" ) ) {
+		o->native = va_arg( argp,int );
+	} else if( !strcmp( name,"%" ) ) {
+		o->n_primes = va_arg( argp,unsigned );
+		assert( o->n_primes<=QS_MODULAR_MAX_PRIMES );
 	} else {
 		const char* substitution = va_arg( argp,char* );
 
@@ -222,6 +304,603 @@ static void init_fermat( QsEvaluator e ) {
 		fprintf( stderr,"Warning: FERMAT initialization failed and reissued\n" );
 }
 
+static uint64_t splitmix( uint64_t* state ) {
+	uint64_t z = ( *state += 0x9E3779B97F4A7C15u );
+	z = ( z ^( z>>30 ) )*0xBF58476D1CE4E5B9u;
+	z = ( z ^( z>>27 ) )*0x94D049BB133111EBu;
+	return z ^( z>>31 );
+}
+
+/** Full product of two 64 bit integers
+ *
+ * @param[out] High 64 bits of the product
+ * @return Low 64 bits of the product
+ */
+static uint64_t mulwide( uint64_t a,uint64_t b,uint64_t* high ) {
+#ifdef __SIZEOF_INT128__
+	const unsigned __int128 product = (unsigned __int128)a*b;
+	*high = product>>64;
+	return product;
+#else
+	const uint64_t a0 = a & 0xFFFFFFFFu,a1 = a>>32;
+	const uint64_t b0 = b & 0xFFFFFFFFu,b1 = b>>32;
+
+	const uint64_t low = a0*b0;
+	const uint64_t middle = a1*b0 +( low>>32 );
+	const uint64_t cross = a0*b1 +( middle & 0xFFFFFFFFu );
+
+	*high = a1*b1 +( middle>>32 )+( cross>>32 );
+	return ( cross<<32 )|( low & 0xFFFFFFFFu );
+#endif
+}
+
+/** Product of two residues modulo the k-th prime
+ *
+ * The product x<2^126 is divided by Barrett's estimate
+ * q=((x>>62)*floor(2^126/p))>>64 of the quotient. Since the primes lie
+ * just below 2^63, floor(2^126/p) is nearly exact and q falls short by at
+ * most 1. The remainder x-q*p is thus below 2p<2^64 and takes a single
+ * correction, all in 64 bits.
+ */
+static uint64_t mulmod( uint64_t a,uint64_t b,unsigned k ) {
+	const uint64_t p = primes[ k ];
+
+	uint64_t high;
+	const uint64_t low = mulwide( a,b,&high );
+
+	uint64_t q;
+	mulwide( ( high<<2 )|( low>>62 ),barrett[ k ],&q );
+
+	const uint64_t r = low - q*p;
+	return r>=p ? r - p : r;
+}
+
+/** Sum of two residues modulo the k-th prime
+ */
+static uint64_t addmod( uint64_t a,uint64_t b,unsigned k ) {
+	const uint64_t sum = a + b;
+	return sum>=primes[ k ]? sum - primes[ k ]: sum;
+}
+
+/** Modular inverse by the extended euclidean algorithm
+ *
+ * All intermediate values stay below the modulus in magnitude.
+ */
+static uint64_t invmod( uint64_t a,uint64_t p ) {
+	int64_t t = 0,next_t = 1;
+	int64_t r = p,next_r = a;
+
+	while( next_r ) {
+		const int64_t q = r/next_r;
+		int64_t swap;
+
+		swap = t - q*next_t;
+		t = next_t;
+		next_t = swap;
+
+		swap = r - q*next_r;
+		r = next_r;
+		next_r = swap;
+	}
+
+	return t<0 ? t + p : t;
+}
+
+static void value_init( QsEvaluator e,struct Value* v ) {
+	if( !e->n_primes )
+		mpq_init( v->rational );
+}
+
+static void value_clear( QsEvaluator e,struct Value* v ) {
+	if( !e->n_primes )
+		mpq_clear( v->rational );
+}
+
+static void value_set( QsEvaluator e,struct Value* v,const struct Value* w ) {
+	if( e->n_primes )
+		memcpy( v->residues,w->residues,e->n_primes*sizeof (uint64_t) );
+	else
+		mpq_set( v->rational,w->rational );
+}
+
+static void value_swap( QsEvaluator e,struct Value* v,struct Value* w ) {
+	if( e->n_primes ) {
+		uint64_t swap[ QS_MODULAR_MAX_PRIMES ];
+		memcpy( swap,v->residues,e->n_primes*sizeof (uint64_t) );
+		memcpy( v->residues,w->residues,e->n_primes*sizeof (uint64_t) );
+		memcpy( w->residues,swap,e->n_primes*sizeof (uint64_t) );
+	} else
+		mpq_swap( v->rational,w->rational );
+}
+
+/** Set value from a string of decimal digits
+ *
+ * Residues are accumulated in chunks of 18 digits, which fit into 64 bits
+ * along with their power of ten.
+ */
+static void value_set_digits( QsEvaluator e,struct Value* v,const char* begin,const char* end ) {
+	if( !e->n_primes ) {
+		char* digits = strndup( begin,end - begin );
+		mpz_set_str( mpq_numref( v->rational ),digits,10 );
+		mpz_set_ui( mpq_denref( v->rational ),1 );
+		free( digits );
+
+		return;
+	}
+
+	unsigned k;
+	for( k = 0; k<e->n_primes; k++ )
+		v->residues[ k ]= 0;
+
+	while( begin!=end ) {
+		uint64_t chunk = 0;
+		uint64_t shift = 1;
+
+		for( ; begin!=end && shift<1000000000000000000u; begin++ ) {
+			chunk = 10*chunk + *begin - '0';
+			shift *= 10;
+		}
+
+		for( k = 0; k<e->n_primes; k++ )
+			v->residues[ k ]= addmod( mulmod( v->residues[ k ],shift,k ),chunk%primes[ k ],k );
+	}
+}
+
+static void value_neg( QsEvaluator e,struct Value* v ) {
+	if( !e->n_primes ) {
+		mpq_neg( v->rational,v->rational );
+		return;
+	}
+
+	unsigned k;
+	for( k = 0; k<e->n_primes; k++ )
+		if( v->residues[ k ]!=MODULAR_UNDEFINED && v->residues[ k ] )
+			v->residues[ k ]= primes[ k ]- v->residues[ k ];
+}
+
+static void value_add( QsEvaluator e,struct Value* v,const struct Value* w ) {
+	if( !e->n_primes ) {
+		mpq_add( v->rational,v->rational,w->rational );
+		return;
+	}
+
+	unsigned k;
+	for( k = 0; k<e->n_primes; k++ )
+		if( v->residues[ k ]==MODULAR_UNDEFINED || w->residues[ k ]==MODULAR_UNDEFINED )
+			v->residues[ k ]= MODULAR_UNDEFINED;
+		else
+			v->residues[ k ]= addmod( v->residues[ k ],w->residues[ k ],k );
+}
+
+static void value_sub( QsEvaluator e,struct Value* v,const struct Value* w ) {
+	if( !e->n_primes ) {
+		mpq_sub( v->rational,v->rational,w->rational );
+		return;
+	}
+
+	unsigned k;
+	for( k = 0; k<e->n_primes; k++ )
+		if( v->residues[ k ]==MODULAR_UNDEFINED || w->residues[ k ]==MODULAR_UNDEFINED )
+			v->residues[ k ]= MODULAR_UNDEFINED;
+		else
+			v->residues[ k ]= addmod( v->residues[ k ],primes[ k ]- w->residues[ k ],k );
+}
+
+static void value_mul( QsEvaluator e,struct Value* v,const struct Value* w ) {
+	if( !e->n_primes ) {
+		mpq_mul( v->rational,v->rational,w->rational );
+		return;
+	}
+
+	unsigned k;
+	for( k = 0; k<e->n_primes; k++ )
+		if( v->residues[ k ]==MODULAR_UNDEFINED || w->residues[ k ]==MODULAR_UNDEFINED )
+			v->residues[ k ]= MODULAR_UNDEFINED;
+		else
+			v->residues[ k ]= mulmod( v->residues[ k ],w->residues[ k ],k );
+}
+
+/** Invert value
+ *
+ * @return False if an exact rational zero was inverted. Residues which
+ * vanish become undefined instead.
+ */
+static bool value_inv( QsEvaluator e,struct Value* v ) {
+	if( !e->n_primes ) {
+		if( !mpq_sgn( v->rational ) )
+			return false;
+
+		mpq_inv( v->rational,v->rational );
+		return true;
+	}
+
+	unsigned k;
+	for( k = 0; k<e->n_primes; k++ )
+		if( v->residues[ k ]==0 )
+			v->residues[ k ]= MODULAR_UNDEFINED;
+		else if( v->residues[ k ]!=MODULAR_UNDEFINED )
+			v->residues[ k ]= invmod( v->residues[ k ],primes[ k ] );
+
+	return true;
+}
+
+static bool value_div( QsEvaluator e,struct Value* v,const struct Value* w ) {
+	if( !e->n_primes ) {
+		if( !mpq_sgn( w->rational ) )
+			return false;
+
+		mpq_div( v->rational,v->rational,w->rational );
+		return true;
+	}
+
+	struct Value inverse;
+	value_set( e,&inverse,w );
+	value_inv( e,&inverse );
+	value_mul( e,v,&inverse );
+
+	return true;
+}
+
+static bool value_pow( QsEvaluator e,struct Value* v,long n ) {
+	if( n<0 &&( n = -n,!value_inv( e,v ) ) )
+		return false;
+
+	if( !e->n_primes ) {
+		mpz_pow_ui( mpq_numref( v->rational ),mpq_numref( v->rational ),n );
+		mpz_pow_ui( mpq_denref( v->rational ),mpq_denref( v->rational ),n );
+
+		return true;
+	}
+
+	unsigned k;
+	for( k = 0; k<e->n_primes; k++ ) {
+		if( v->residues[ k ]==MODULAR_UNDEFINED )
+			continue;
+
+		uint64_t base = v->residues[ k ];
+		uint64_t power = 1;
+		long m;
+		for( m = n; m; m >>= 1 ) {
+			if( m & 1 )
+				power = mulmod( power,base,k );
+			base = mulmod( base,base,k );
+		}
+
+		v->residues[ k ]= power;
+	}
+
+	return true;
+}
+
+/** String representation of value
+ *
+ * Rationals are printed like FERMAT does. Residues are printed as
+ * '{r1,r2,...}' with '?' for undefined ones, except if they are all 0 or
+ * all 1, in which case the value is printed as such.
+ *
+ * @param This
+ * @param The value
+ * @return[transfer=full] The string
+ */
+static char* value_print( QsEvaluator e,const struct Value* v ) {
+	if( !e->n_primes )
+		return mpq_get_str( NULL,10,v->rational );
+
+	bool zero = true;
+	bool one = true;
+
+	unsigned k;
+	for( k = 0; k<e->n_primes; k++ ) {
+		zero = zero && v->residues[ k ]==0;
+		one = one && v->residues[ k ]==1;
+	}
+
+	if( zero || one )
+		return strdup( zero?"0":"1" );
+
+	char* result = malloc( e->n_primes*21 + 2 );
+	char* w = result;
+
+	*w++ = '{';
+	for( k = 0; k<e->n_primes; k++ ) {
+		if( v->residues[ k ]==MODULAR_UNDEFINED )
+			*w++ = '?';
+		else
+			w += sprintf( w,"%" PRIu64,v->residues[ k ] );
+
+		*w++ = k + 1<e->n_primes ? ',' : '}';
+	}
+	*w = '\0';
+
+	return result;
+}
+
+/** Native parser state
+ *
+ * Coefficients are parsed by recursive descent directly into values,
+ * with every symbol replaced by its numeric value as it is encountered.
+ */
+struct Parser {
+	const char* at;
+	QsEvaluator e;
+};
+
+static bool parse_sum( struct Parser*,struct Value* );
+
+static void parse_blank( struct Parser* p ) {
+	while( isspace( (unsigned char)*p->at ) )
+		p->at++;
+}
+
+/** Parse the residues of a previous modular evaluation
+ */
+static bool parse_residues( struct Parser* p,struct Value* out ) {
+	unsigned k;
+	for( k = 0; k<p->e->n_primes; k++ ) {
+		parse_blank( p );
+
+		if( *p->at=='?' ) {
+			out->residues[ k ]= MODULAR_UNDEFINED;
+			p->at++;
+		} else if( isdigit( (unsigned char)*p->at ) ) {
+			char* end;
+			out->residues[ k ]= strtoull( p->at,&end,10 );
+			p->at = end;
+		} else
+			return false;
+
+		parse_blank( p );
+		if( *p->at++!=( k + 1<p->e->n_primes ? ',' : '}' ) )
+			return false;
+	}
+
+	return true;
+}
+
+static bool parse_primary( struct Parser* p,struct Value* out ) {
+	parse_blank( p );
+
+	if( *p->at=='(' ) {
+		p->at++;
+		if( !parse_sum( p,out ) )
+			return false;
+
+		parse_blank( p );
+		if( *p->at!=')' )
+			return false;
+
+		p->at++;
+		return true;
+	}
+
+	if( *p->at=='{' && p->e->n_primes ) {
+		p->at++;
+		return parse_residues( p,out );
+	}
+
+	const char* begin = p->at;
+
+	if( isdigit( (unsigned char)*p->at ) ) {
+		while( isdigit( (unsigned char)*p->at ) )
+			p->at++;
+
+		value_set_digits( p->e,out,begin,p->at );
+		return true;
+	}
+
+	while( isalnum( (unsigned char)*p->at ) || *p->at=='_' )
+		p->at++;
+
+	if( p->at==begin || !p->e->values )
+		return false;
+
+	unsigned j;
+	for( j = 0; j<p->e->n_symbols; j++ )
+		if( !strncmp( p->e->symbols[ j ],begin,p->at - begin ) && p->e->symbols[ j ][ p->at - begin ]=='\0' ) {
+			value_set( p->e,out,p->e->values + j );
+			return true;
+		}
+
+	return false;
+}
+
+/** Parse an exponent
+ *
+ * Exponents are integer literals, possibly signed and parenthesized.
+ */
+static bool parse_exponent( struct Parser* p,long* out ) {
+	parse_blank( p );
+
+	if( *p->at=='(' ) {
+		p->at++;
+		if( !parse_exponent( p,out ) )
+			return false;
+
+		parse_blank( p );
+		return *p->at++==')';
+	}
+
+	if( *p->at=='-' || *p->at=='+' ) {
+		const bool minus = *p->at++=='-';
+		if( !parse_exponent( p,out ) )
+			return false;
+
+		if( minus )
+			*out = -*out;
+
+		return true;
+	}
+
+	if( !isdigit( (unsigned char)*p->at ) )
+		return false;
+
+	char* end;
+	errno = 0;
+	*out = strtol( p->at,&end,10 );
+	p->at = end;
+
+	return errno!=ERANGE;
+}
+
+static bool parse_power( struct Parser* p,struct Value* out ) {
+	parse_blank( p );
+
+	if( *p->at=='-' || *p->at=='+' ) {
+		const bool minus = *p->at++=='-';
+		if( !parse_power( p,out ) )
+			return false;
+
+		if( minus )
+			value_neg( p->e,out );
+
+		return true;
+	}
+
+	if( !parse_primary( p,out ) )
+		return false;
+
+	parse_blank( p );
+	if( *p->at!='^' )
+		return true;
+
+	p->at++;
+
+	long n;
+	return parse_exponent( p,&n )&& value_pow( p->e,out,n );
+}
+
+static bool parse_product( struct Parser* p,struct Value* out ) {
+	if( !parse_power( p,out ) )
+		return false;
+
+	struct Value factor;
+	value_init( p->e,&factor );
+
+	bool valid = true;
+	parse_blank( p );
+	while( valid &&( *p->at=='*' || *p->at=='/' ) ) {
+		const bool divide = *p->at++=='/';
+
+		if( !( valid = parse_power( p,&factor ) ) )
+			break;
+
+		if( divide )
+			valid = value_div( p->e,out,&factor );
+		else
+			value_mul( p->e,out,&factor );
+
+		parse_blank( p );
+	}
+
+	value_clear( p->e,&factor );
+
+	return valid;
+}
+
+static bool parse_sum( struct Parser* p,struct Value* out ) {
+	if( !parse_product( p,out ) )
+		return false;
+
+	struct Value term;
+	value_init( p->e,&term );
+
+	bool valid = true;
+	parse_blank( p );
+	while( valid &&( *p->at=='+' || *p->at=='-' ) ) {
+		const bool subtract = *p->at++=='-';
+
+		if( !( valid = parse_product( p,&term ) ) )
+			break;
+
+		if( subtract )
+			value_sub( p->e,out,&term );
+		else
+			value_add( p->e,out,&term );
+
+		parse_blank( p );
+	}
+
+	value_clear( p->e,&term );
+
+	return valid;
+}
+
+/** Parse text into a value
+ *
+ * @param This
+ * @param Text of a coefficient in the syntax produced by FERMAT
+ * @param[out] The value of the text with all symbols substituted
+ * @return Whether the text was valid and completely consumed
+ */
+static bool parse_value( QsEvaluator e,const char* text,struct Value* out ) {
+	struct Parser p = { text,e };
+
+	if( !parse_sum( &p,out ) )
+		return false;
+
+	parse_blank( &p );
+	return *p.at=='\0';
+}
+
+static struct Native* native_new( QsEvaluator e ) {
+	struct Native* result = malloc( sizeof (struct Native) );
+	result->domain = e->domain;
+	result->n_primes = e->n_primes;
+	value_init( e,&result->value );
+
+	return result;
+}
+
+static void native_destroy( struct Native* n ) {
+	if( n && !n->n_primes )
+		mpq_clear( n->value.rational );
+
+	free( n );
+}
+
+/** Value of a coefficient
+ *
+ * Parses the coefficient only if it has no value yet, which is then kept
+ * with it. Evaluators may look up the same coefficient concurrently, the
+ * first value stored is kept.
+ *
+ * @param This
+ * @param The coefficient
+ * @param[out] Where the value is parsed into if the coefficient keeps
+ * one for another domain
+ * @return The value or NULL if the coefficient is invalid
+ */
+static const struct Value* native_value( QsEvaluator e,QsCoefficient c,struct Value* scratch ) {
+	struct Native* n = atomic_load_explicit( &c->native,memory_order_acquire );
+
+	if( !n ) {
+		n = native_new( e );
+		if( !parse_value( e,c->text,&n->value ) ) {
+			native_destroy( n );
+			return NULL;
+		}
+
+		struct Native* expected = NULL;
+		if( !atomic_compare_exchange_strong_explicit( &c->native,&expected,n,memory_order_acq_rel,memory_order_acquire ) ) {
+			native_destroy( n );
+			n = expected;
+		}
+	}
+
+	if( n->domain==e->domain )
+		return &n->value;
+
+	return parse_value( e,c->text,scratch ) ? scratch : NULL;
+}
+
+static uint64_t hash_string( uint64_t hash,const char* s ) {
+	do
+		hash =( hash^(unsigned char)*s )*0x100000001b3u;
+	while( *s++ );
+
+	return hash;
+}
+
 QsEvaluator qs_evaluator_new( QsCompoundDiscoverer discover,QsEvaluatorOptions opts ) {
 	QsEvaluator result = malloc( sizeof (struct QsEvaluator) );
 	result->discover = discover;
@@ -252,6 +931,42 @@ QsEvaluator qs_evaluator_new( QsCompoundDiscoverer discover,QsEvaluatorOptions o
 			result->substitutions[ j ]= NULL;
 	}
 
+	result->native = opts->native || opts->n_primes;
+	result->n_primes = opts->n_primes;
+	result->values = NULL;
+
+	/* The domain covers whatever determines the values of the symbols */
+	result->domain =( 0xcbf29ce484222325u^opts->n_primes )*0x100000001b3u;
+	if( result->n_primes )
+		result->domain =( result->domain^opts->seed )*0x100000001b3u;
+	for( j = 0; j<opts->n_symbols; j++ ) {
+		result->domain = hash_string( result->domain,opts->symbols[ j ] );
+		result->domain = hash_string( result->domain,opts->substitutions[ j ] ? opts->substitutions[ j ] : "" );
+	}
+
+	if( result->native ) {
+		value_init( result,&result->result );
+
+		/* All evaluators of the same options draw the same points */
+		uint64_t state = opts->seed;
+
+		struct Value* values = malloc( opts->n_symbols*sizeof (struct Value) );
+		for( j = 0; j<opts->n_symbols; j++ ) {
+			value_init( result,values + j );
+
+			if( !opts->substitutions[ j ]&& result->n_primes ) {
+				unsigned k;
+				for( k = 0; k<result->n_primes; k++ )
+					values[ j ].residues[ k ]= splitmix( &state )%primes[ k ];
+			} else if( !opts->substitutions[ j ]|| !parse_value( result,opts->substitutions[ j ],values + j ) ) {
+				fprintf( stderr,"Error: Symbol '%s' requires a rational value for native evaluation\n",opts->symbols[ j ] );
+				abort( );
+			}
+		}
+
+		result->values = values;
+	}
+
 	return result;
 }
 
@@ -297,6 +1012,68 @@ static void submit_compound( QsEvaluator e,QsCompound x,QsOperation op ) {
 	}
 }
 
+/** Evaluate a compound natively
+ *
+ * The counterpart of submit_compound which, instead of writing the
+ * compound to FERMAT, combines the values of its operands right away.
+ *
+ * @param This
+ * @param The compound
+ * @param The operation associated with the compound
+ * @param[out] The value of the compound
+ */
+static void native_compound( QsEvaluator e,QsCompound x,QsOperation op,struct Value* out ) {
+	struct Value value;
+	value_init( e,&value );
+
+	QsCompound child_raw;
+	bool is_compound;
+	QsOperation child_op;
+	unsigned j;
+	for( j = 0; ( child_raw = e->discover( x,j,&is_compound,&child_op ) ); j++ ) {
+		const struct Value* operand = &value;
+
+		if( is_compound )
+			native_compound( e,child_raw,child_op,&value );
+		else {
+			QsCoefficient child = (QsCoefficient)child_raw;
+			if( !( operand = native_value( e,child,&value ) ) ) {
+				fprintf( stderr,"Error: Coefficient '%s' can not be evaluated natively\n",child->text );
+				abort( );
+			}
+		}
+
+		bool valid = true;
+		if( j==0 ) {
+			if( operand==&value )
+				value_swap( e,out,&value );
+			else
+				value_set( e,out,operand );
+
+			if( !e->discover( x,1,NULL,NULL ) ) {
+				if( op==QS_OPERATION_SUB )
+					value_neg( e,out );
+				else if( op==QS_OPERATION_DIV )
+					valid = value_inv( e,out );
+			}
+		} else if( op==QS_OPERATION_ADD )
+			value_add( e,out,operand );
+		else if( op==QS_OPERATION_SUB )
+			value_sub( e,out,operand );
+		else if( op==QS_OPERATION_MUL )
+			value_mul( e,out,operand );
+		else if( op==QS_OPERATION_DIV )
+			valid = value_div( e,out,operand );
+
+		if( !valid ) {
+			fprintf( stderr,"Error: Division by zero in native evaluation\n" );
+			abort( );
+		}
+	}
+
+	value_clear( e,&value );
+}
+
 QsCoefficient qs_coefficient_one( bool minus ) {
 	return qs_coefficient_new_from_binary( minus?"-1":"1",minus?2:1 );
 }
@@ -310,6 +1087,11 @@ static void finish_fermat( QsEvaluator e ) {
 }
 
 void qs_evaluator_evaluate( QsEvaluator e,QsCompound x,QsOperation op ) {
+	if( e->native ) {
+		native_compound( e,x,op,&e->result );
+		return;
+	}
+
 	if( e->evaluations==0 ) {
 		init_fermat( e );
 		e->evaluations++;
@@ -322,9 +1104,18 @@ QsCoefficient qs_evaluator_receive( QsEvaluator e ) {
 	QsCoefficient result = NULL;
 	char* text;
 
+	if( e->native ) {
+		struct Native* n = native_new( e );
+		value_swap( e,&n->value,&e->result );
+
+		result = qs_coefficient_new_with_string( value_print( e,&n->value ) );
+		atomic_store_explicit( &result->native,n,memory_order_relaxed );
+
+		return result;
+	}
+
 	if( fermat_sync( e,&text ) ) {
-		result = malloc( sizeof (struct QsCoefficient) );
-		result->text = text;
+		result = qs_coefficient_new_with_string( text );
 
 		if( e->max_evaluations ) {
 			e->evaluations++;
@@ -348,6 +1139,14 @@ void qs_evaluator_destroy( QsEvaluator e ) {
 			free( e->substitutions[ j ] );
 	}
 
+	if( e->native ) {
+		for( j = 0; j<e->n_symbols; j++ )
+			value_clear( e,e->values + j );
+
+		value_clear( e,&e->result );
+		free( e->values );
+	}
+
 #ifdef DBG_EVALFILE
 	fclose( e->fermat_log );
 #endif
@@ -359,22 +1158,25 @@ void qs_evaluator_destroy( QsEvaluator e ) {
 }
 
 QsCoefficient qs_coefficient_new_from_binary( const char* data,size_t size ) {
-	QsCoefficient result = malloc( sizeof (QsCoefficient) );
+	QsCoefficient result = malloc( sizeof (struct QsCoefficient) );
 	result->text = malloc( size+1 );
 	memcpy( result->text,data,size );
 	result->text[ size ]= '\0';
+	atomic_init( &result->native,NULL );
 
 	return result;
 }
 
 QsCoefficient qs_coefficient_new_with_string( char* data ) {
-	QsCoefficient result = malloc( sizeof (QsCoefficient) );
+	QsCoefficient result = malloc( sizeof (struct QsCoefficient) );
 	result->text = data;
+	atomic_init( &result->native,NULL );
 	return result;
 }	
 
 char* qs_coefficient_disband( QsCoefficient c ) {
 	char* result = c->text;
+	native_destroy( atomic_load_explicit( &c->native,memory_order_relaxed ) );
 	free( c );
 	return result;
 }
@@ -392,6 +1194,21 @@ size_t qs_coefficient_print( const QsCoefficient c,char** b ) {
 	return strlen( c->text );
 }
 
+/** Write string representation of coefficient
+ *
+ * Writes the coefficient into the given memory without allocation. The
+ * result is not terminated.
+ *
+ * @param This
+ * @param Memory of at least qs_coefficient_size bytes
+ * @return Length of written string
+ */
+size_t qs_coefficient_format( const QsCoefficient c,char* b ) {
+	size_t len = strlen( c->text );
+	memcpy( b,c->text,len );
+	return len;
+}
+
 bool qs_coefficient_is_one( const QsCoefficient c ) {
 	return !strcmp( c->text,"1" );
 }
@@ -401,6 +1218,7 @@ bool qs_coefficient_is_zero( const QsCoefficient c ) {
 }
 
 void qs_coefficient_destroy( QsCoefficient c ) {
+	native_destroy( atomic_load_explicit( &c->native,memory_order_relaxed ) );
 	free( c->text );
 	free( c );
 }
@@ -409,29 +1227,256 @@ size_t qs_coefficient_size( QsCoefficient c ) {
 	return strlen( c->text )+ 1;
 }
 
-static char* replace_first( char* base,size_t offset,const char* pattern,const char *replacement,size_t base_len,size_t pattern_len,size_t replacement_len ) {
-	char* location = strstr( base + offset,pattern );
+struct Pattern {
+	size_t pattern_len;
+	char* replacement; ///< Parenthesized value
+	size_t replacement_len;
+};
+
+struct State {
+	unsigned next[ UCHAR_MAX + 1 ];
+	int pattern; ///< Pattern ending in this state or -1
+	unsigned output; ///< Next state along failure links with a pattern or 0
+};
 
-	if( location ) {
-		size_t first = location - base;
+struct Match {
+	size_t begin;
+	unsigned pattern;
+};
 
-		if( pattern_len<replacement_len )
-			base = realloc( base,base_len + replacement_len - pattern_len + 1 );
+/** Compiled substitution set
+ *
+ * An Aho-Corasick automaton over all substituted symbols. The goto and
+ * failure functions are folded into a complete transition table such
+ * that a coefficient is scanned once with one lookup per character.
+ */
+struct QsSubstitution {
+	unsigned n_patterns;
+	char** patterns;
+	struct Pattern* compiled;
+
+	unsigned n_states;
+	struct State* states;
+};
 
-		memmove( base + first + replacement_len,base + first + pattern_len,base_len - first - pattern_len );
-		memcpy( base + first,replacement,replacement_len );
-		base_len =( base_len + replacement_len )- pattern_len;
-		base[ base_len ]= '\0';
+QsSubstitution qs_substitution_new( ) {
+	QsSubstitution result = malloc( sizeof (struct QsSubstitution) );
+	result->n_patterns = 0;
+	result->patterns = malloc( 0 );
+	result->compiled = malloc( 0 );
+	result->n_states = 0;
+	result->states = malloc( 0 );
+	return result;
+}
 
-		return replace_first( base,first + replacement_len,pattern,replacement,base_len,pattern_len,replacement_len );
-	} else
-		return base;
+static unsigned state_new( QsSubstitution s ) {
+	s->states = realloc( s->states,( s->n_states + 1 )*sizeof (struct State) );
+	memset( s->states[ s->n_states ].next,0,sizeof s->states[ s->n_states ].next );
+	s->states[ s->n_states ].pattern = -1;
+	s->states[ s->n_states ].output = 0;
+	return s->n_states++;
 }
 
-void qs_coefficient_substitute( QsCoefficient c,const char* pattern,const char* replacement ) {
-	char* replacer = malloc( strlen( replacement )+ 3 );
+static void compile( QsSubstitution s ) {
+	s->n_states = 0;
+	state_new( s );
 
-	sprintf( replacer,"(%s)",replacement );
-	c->text = replace_first( c->text,0,pattern,replacer,strlen( c->text ),strlen( pattern ),strlen( replacer ) );
-	free( replacer );
-}	
+	/* Trie, where the edges are only recorded as long as the automaton is
+	 * incomplete. An edge to state 0 means no edge, since the root is no
+	 * target within the trie. */
+	int j;
+	for( j = 0; j<s->n_patterns; j++ ) {
+		const unsigned char* c;
+		unsigned state = 0;
+		for( c = (const unsigned char*)s->patterns[ j ]; *c; c++ ) {
+			if( !s->states[ state ].next[ *c ] ) {
+				unsigned target = state_new( s );
+				s->states[ state ].next[ *c ]= target;
+			}
+
+			state = s->states[ state ].next[ *c ];
+		}
+
+		/* Earlier substitutions of the same symbol take precedence */
+		if( state && s->states[ state ].pattern<0 )
+			s->states[ state ].pattern = j;
+	}
+
+	/* Breadth first completion of the transitions by means of the failure
+	 * links. The states of the trie are numbered such that a parent is
+	 * always enumerated before its children, but not breadth first, hence
+	 * the queue. */
+	unsigned* queue = malloc( s->n_states*sizeof (unsigned) );
+	unsigned* fail = malloc( s->n_states*sizeof (unsigned) );
+	unsigned queue_begin = 0;
+	unsigned queue_end = 0;
+
+	int c;
+	for( c = 0; c<=UCHAR_MAX; c++ )
+		if( s->states[ 0 ].next[ c ] ) {
+			fail[ s->states[ 0 ].next[ c ] ]= 0;
+			queue[ queue_end++ ]= s->states[ 0 ].next[ c ];
+		}
+
+	while( queue_begin!=queue_end ) {
+		const unsigned state = queue[ queue_begin++ ];
+		const unsigned f = fail[ state ];
+
+		s->states[ state ].output = s->states[ f ].pattern>=0?f:s->states[ f ].output;
+
+		for( c = 0; c<=UCHAR_MAX; c++ ) {
+			const unsigned target = s->states[ state ].next[ c ];
+
+			if( target ) {
+				fail[ target ]= s->states[ f ].next[ c ];
+				queue[ queue_end++ ]= target;
+			} else
+				s->states[ state ].next[ c ]= s->states[ f ].next[ c ];
+		}
+	}
+
+	free( queue );
+	free( fail );
+}
+
+/** Add a substitution
+ *
+ * Registers that every occurrence of a symbol shall be replaced by the
+ * parenthesized value. Must not be called concurrently with any other
+ * function on the same substitution set.
+ *
+ * @param This
+ * @param Symbol
+ * @param Value
+ */
+void qs_substitution_add( QsSubstitution s,const char* pattern,const char* replacement ) {
+	s->patterns = realloc( s->patterns,( s->n_patterns + 1 )*sizeof (char*) );
+	s->compiled = realloc( s->compiled,( s->n_patterns + 1 )*sizeof (struct Pattern) );
+
+	struct Pattern* p = s->compiled + s->n_patterns;
+	s->patterns[ s->n_patterns ]= strdup( pattern );
+	p->pattern_len = strlen( pattern );
+	p->replacement_len = asprintf( &p->replacement,"(%s)",replacement );
+
+	s->n_patterns++;
+
+	compile( s );
+}
+
+static int match_cmp( const void* a,const void* b,void* data ) {
+	const struct Match* ma = a;
+	const struct Match* mb = b;
+	const struct Pattern* patterns = data;
+
+	if( ma->begin!=mb->begin )
+		return ma->begin<mb->begin?-1:1;
+
+	/* Longer matches first */
+	const size_t la = patterns[ ma->pattern ].pattern_len;
+	const size_t lb = patterns[ mb->pattern ].pattern_len;
+
+	return la==lb?0:( la>lb?-1:1 );
+}
+
+/** Substitute symbols
+ *
+ * Replaces all symbols of the substitution set in the coefficient in a
+ * single pass. Where occurrences overlap, the leftmost and then the
+ * longest one is replaced. Symbols within the substituted values are
+ * not substituted in turn. May be called concurrently.
+ *
+ * @param This
+ * @param Substitution set
+ */
+void qs_coefficient_substitute( QsCoefficient c,const QsSubstitution s ) {
+	if( !s->n_patterns )
+		return;
+
+	size_t n_matches = 0;
+	size_t allocated = SUBSTITUTE_PREALLOC;
+	struct Match prealloc[ SUBSTITUTE_PREALLOC ];
+	struct Match* matches = prealloc;
+
+	const unsigned char* text = (const unsigned char*)c->text;
+	unsigned state = 0;
+
+	size_t j;
+	for( j = 0; text[ j ]; j++ ) {
+		state = s->states[ state ].next[ text[ j ] ];
+
+		unsigned out;
+		for( out = s->states[ state ].pattern>=0?state:s->states[ state ].output; out; out = s->states[ out ].output ) {
+			if( n_matches==allocated ) {
+				allocated *= 2;
+
+				if( matches==prealloc ) {
+					matches = malloc( allocated*sizeof (struct Match) );
+					memcpy( matches,prealloc,sizeof prealloc );
+				} else
+					matches = realloc( matches,allocated*sizeof (struct Match) );
+			}
+
+			const unsigned p = s->states[ out ].pattern;
+			matches[ n_matches++ ]= (struct Match){ j + 1 - s->compiled[ p ].pattern_len,p };
+		}
+	}
+
+	if( !n_matches )
+		return;
+
+	const size_t len = j;
+
+	/* Matches are found in order of their end, which may differ from the
+	 * order of their beginnings when symbols are contained in one
+	 * another. */
+	qsort_r( matches,n_matches,sizeof (struct Match),match_cmp,s->compiled );
+
+	size_t n_accepted = 0;
+	size_t size = len;
+	size_t end = 0;
+	for( j = 0; j<n_matches; j++ )
+		if( !( matches[ j ].begin<end ) ) {
+			const struct Pattern* p = s->compiled + matches[ j ].pattern;
+
+			matches[ n_accepted++ ]= matches[ j ];
+			end = matches[ j ].begin + p->pattern_len;
+			size = size + p->replacement_len - p->pattern_len;
+		}
+
+	char* result = malloc( size + 1 );
+	char* w = result;
+	size_t r = 0;
+	for( j = 0; j<n_accepted; j++ ) {
+		const struct Pattern* p = s->compiled + matches[ j ].pattern;
+
+		memcpy( w,c->text + r,matches[ j ].begin - r );
+		w += matches[ j ].begin - r;
+		memcpy( w,p->replacement,p->replacement_len );
+		w += p->replacement_len;
+		r = matches[ j ].begin + p->pattern_len;
+	}
+
+	memcpy( w,c->text + r,len - r );
+	result[ size ]= '\0';
+
+	if( matches!=prealloc )
+		free( matches );
+
+	free( c->text );
+	c->text = result;
+
+	native_destroy( atomic_exchange_explicit( &c->native,NULL,memory_order_relaxed ) );
+}
+
+void qs_substitution_destroy( QsSubstitution s ) {
+	int j;
+	for( j = 0; j<s->n_patterns; j++ ) {
+		free( s->patterns[ j ] );
+		free( s->compiled[ j ].replacement );
+	}
+
+	free( s->patterns );
+	free( s->compiled );
+	free( s->states );
+	free( s );
+}
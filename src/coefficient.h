@@ -4,6 +4,8 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+#define QS_MODULAR_MAX_PRIMES 8
+
 typedef enum {
 	QS_OPERATION_ADD,
 	QS_OPERATION_SUB,
@@ -15,6 +17,7 @@ typedef void* QsCompound;
 typedef struct QsCoefficient* QsCoefficient;
 typedef struct QsEvaluator* QsEvaluator;
 typedef struct QsEvaluatorOptions* QsEvaluatorOptions;
+typedef struct QsSubstitution* QsSubstitution;
 
 /** Discover callback for compounds
  *
@@ -56,14 +59,19 @@ void qs_evaluator_destroy( QsEvaluator );
 
 QsCoefficient qs_coefficient_new_from_binary( const char*,size_t );
 size_t qs_coefficient_print( const QsCoefficient,char** );
+size_t qs_coefficient_format( const QsCoefficient,char* );
 bool qs_coefficient_is_one( const QsCoefficient );
 bool qs_coefficient_is_zero( const QsCoefficient );
 QsCoefficient qs_coefficient_one( bool );
 size_t qs_coefficient_to_binary( QsCoefficient,char** );
 void qs_coefficient_destroy( QsCoefficient );
-void qs_coefficient_substitute( QsCoefficient,const char*,const char* );
+void qs_coefficient_substitute( QsCoefficient,const QsSubstitution );
 size_t qs_coefficient_size( QsCoefficient );
 
+QsSubstitution qs_substitution_new( );
+void qs_substitution_add( QsSubstitution,const char*,const char* );
+void qs_substitution_destroy( QsSubstitution );
+
 /** Transforms a coefficient into a string
  *
  * The inverse of qs_coefficient_new_with_string. The coefficient is
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <kclangc.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 /** Kyotocabinet specific workarround
  *
@@ -13,6 +14,13 @@
  */
 #define MAX_OPEN_DBS 511
 
+/** Lock of the tracking state
+ *
+ * Operations on an open database hold it for reading, such that
+ * databases may be used concurrently but are not closed in favour of
+ * another one meanwhile. Opening, closing and (un)tracking databases
+ * hold it for writing. */
+static pthread_rwlock_t tracking_lock = PTHREAD_RWLOCK_INITIALIZER;
 static unsigned n_tracked_dbs;
 static unsigned cache_open_count;
 unsigned allocated;
@@ -114,12 +122,47 @@ static bool assert_open( QsDb db ) {
 		return false;
 }
 
+/** Obtain an open database
+ *
+ * Opens the database if necessary and holds the tracking lock for
+ * reading until release_db.
+ *
+ * @param The database
+ * @return Whether the database is open. If not, no lock is held.
+ */
+static bool acquire_db( QsDb db ) {
+	pthread_rwlock_rdlock( &tracking_lock );
+
+	while( !db->db ) {
+		pthread_rwlock_unlock( &tracking_lock );
+
+		pthread_rwlock_wrlock( &tracking_lock );
+		bool opened = assert_open( db );
+		pthread_rwlock_unlock( &tracking_lock );
+
+		if( !opened )
+			return false;
+
+		pthread_rwlock_rdlock( &tracking_lock );
+	}
+
+	return true;
+}
+
+static void release_db( ) {
+	pthread_rwlock_unlock( &tracking_lock );
+}
+
 void qs_db_destroy( QsDb db ) {
+	pthread_rwlock_wrlock( &tracking_lock );
+
 	untrack_db( db );
 
 	if( db->db )
 		close_db( db );
 
+	pthread_rwlock_unlock( &tracking_lock );
+
 	free( db->pathname );
 	free( db->cursors );
 	free( db );
@@ -149,9 +192,14 @@ QsDb qs_db_new( char* pathname,enum QsDbMode mode ) {
 	result->n_cursors = 0;
 	result->cursors = malloc( 0 );
 
+	pthread_rwlock_wrlock( &tracking_lock );
+
 	track_db( result );
+	bool opened = assert_open( result );
+
+	pthread_rwlock_unlock( &tracking_lock );
 
-	if( assert_open( result ) )
+	if( opened )
 		return result;
 
 	qs_db_destroy( result );
@@ -159,7 +207,11 @@ QsDb qs_db_new( char* pathname,enum QsDbMode mode ) {
 }
 
 QsDbCursor qs_db_cursor_new( QsDb db ) {
-	assert( assert_open( db ) );
+	pthread_rwlock_wrlock( &tracking_lock );
+	bool opened = assert_open( db );
+	pthread_rwlock_unlock( &tracking_lock );
+
+	assert( opened );
 
 	QsDbCursor result = malloc( sizeof (struct QsDbCursor) );
 
@@ -212,10 +264,17 @@ struct QsDbEntry* qs_db_cursor_next( QsDbCursor cur ) {
 }
 
 struct QsDbEntry* qs_db_get( QsDb db,const char* keyname,unsigned keylen ) {
-	assert_open( db );
+	if( !acquire_db( db ) )
+		return NULL;
+
+	/* A single call, because a check for the size followed by a read
+	 * would be racy with concurrent writers */
+	size_t vallen;
+	char* val = kcdbget( db->db,keyname,keylen,&vallen );
+
+	release_db( );
 
-	int32_t vallen = kcdbcheck( db->db,keyname,keylen );
-	if( vallen!=-1 ) {
+	if( val ) {
 		struct QsDbEntry* result = malloc( sizeof (struct QsDbEntry) );
 		result->key = malloc( keylen );
 		result->keylen = keylen;
@@ -223,28 +282,50 @@ struct QsDbEntry* qs_db_get( QsDb db,const char* keyname,unsigned keylen ) {
 		result->vallen = vallen;
 
 		memcpy( result->key,keyname,keylen );
-		kcdbgetbuf( db->db,result->key,keylen,result->val,result->vallen );
+		memcpy( result->val,val,vallen );
+		kcfree( val );
+
 		return result;
 	} else
 		return NULL;
 }
 
 void qs_db_del( QsDb db,const char* keyname,unsigned keylen ) {
-	assert_open( db );
-
-	kcdbremove( db->db,keyname,keylen );
+	if( acquire_db( db ) ) {
+		kcdbremove( db->db,keyname,keylen );
+		release_db( );
+	}
 }
 
 void qs_db_set( QsDb db,struct QsDbEntry* e ) {
-	assert_open( db );
-
-	kcdbset( db->db,e->key,e->keylen,e->val,e->vallen );
+	if( acquire_db( db ) ) {
+		kcdbset( db->db,e->key,e->keylen,e->val,e->vallen );
+		release_db( );
+	}
 }
 
 void qs_db_append( QsDb db,struct QsDbEntry* e ) {
-	assert_open( db );
+	if( acquire_db( db ) ) {
+		kcdbappend( db->db,e->key,e->keylen,e->val,e->vallen );
+		release_db( );
+	}
+}
+
+/** Synchronize a database to disk
+ *
+ * Writes all pending modifications of the database through to the
+ * device. Databases which are currently closed by the workaround have
+ * already been written.
+ *
+ * @param The database
+ */
+void qs_db_sync( QsDb db ) {
+	pthread_rwlock_rdlock( &tracking_lock );
+
+	if( db->db )
+		kcdbsync( db->db,true,NULL,NULL );
 
-	kcdbappend( db->db,e->key,e->keylen,e->val,e->vallen );
+	pthread_rwlock_unlock( &tracking_lock );
 }
 
 void qs_db_entry_destroy( struct QsDbEntry* e ) {
@@ -29,6 +29,7 @@ struct QsDbEntry* qs_db_get( QsDb,const char*,unsigned );
 void qs_db_set( QsDb db,struct QsDbEntry* );
 void qs_db_append( QsDb,struct QsDbEntry* );
 void qs_db_del( QsDb,const char*,unsigned );
+void qs_db_sync( QsDb );
 void qs_db_cursor_destroy( QsDbCursor );
 void qs_db_destroy( QsDb );
 
@@ -43,6 +43,30 @@ QsExpression qs_expression_new_from_binary( const char* data,unsigned len,unsign
 	return result;
 }
 
+/** Extent of a binary expression
+ *
+ * Determines where an expression in binary form ends, like
+ * qs_expression_new_from_binary, but without decoding any of its terms.
+ *
+ * @param Binary data
+ *
+ * @param Length of the data
+ *
+ * @return Number of bytes occupied by the expression
+ */
+unsigned qs_expression_binary_extent( const char* data,unsigned len ) {
+	unsigned c = 0;
+	while( c +( 2*sizeof (int)-1 )<len ) {
+		const char* base = data+c;
+		int len_integral = *( (int*)base );
+		int len_coefficient = *( (int*)( base+sizeof (int)+len_integral ) );
+
+		c += len_integral+len_coefficient+2*sizeof (int);
+	}
+
+	return c;
+}
+
 unsigned qs_expression_to_binary( QsExpression e,char** result ) {
 	size_t size = 0;
 	size_t allocated = 0;
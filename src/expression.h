@@ -4,6 +4,7 @@
 typedef struct QsExpression* QsExpression;
 
 QsExpression qs_expression_new_from_binary( const char*,unsigned,unsigned* );
+unsigned qs_expression_binary_extent( const char*,unsigned );
 QsExpression qs_expression_new_with_size( unsigned );
 
 /** Consumes a coefficient and integral
@@ -5,13 +5,51 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 
+#define INTEGRAL_HASH_OFFSET 14695981039346656037UL
+#define INTEGRAL_HASH_PRIME 1099511628211UL
+
+#define POWER_MAX ( ( 1UL<<( CHAR_BIT*sizeof (QsPower) - 1 ) )- 1 )
+
+_Static_assert( (QsPower)-1<0,"QsPower must be signed" );
+_Static_assert( sizeof (QsPower)<=sizeof (unsigned long),"QsPower must fit into unsigned long" );
+
+/** Integral
+ *
+ * Prototype, number of powers and powers are kept in one allocation so
+ * that an integral can be placed as a single fixed size record into
+ * memory of the caller's choosing (see qs_integral_new_in_place).
+ */
 struct QsIntegral {
 	QsPrototype prototype;
 	unsigned n_powers;
-	QsPower* powers;
+	QsPower powers[ ];
 };
 
+/** Parse the powers of a string representation
+ *
+ * @param Pointer to the opening parenthesis
+ * @param[out] Buffer for the powers or NULL to only count them
+ * @return Number of powers
+ */
+static unsigned parse_powers( const char* power_end,QsPower* powers ) {
+	unsigned result = 0;
+
+	const char* power_base;
+	do {
+		power_base = power_end;
+		long value = strtol( power_base+1,(char**)&power_end,0 );
+		if( power_end!=power_base+1 ) {
+			if( powers )
+				powers[ result ]= value;
+			result++;
+		}
+	} while( power_end!=power_base+1 );
+
+	return result;
+}
+
 QsIntegral qs_integral_new_from_string( const char* s ) {
 	const char* prototype_str = s+2;
 	char* power_end = strchr( s,'(' );
@@ -19,40 +57,197 @@ QsIntegral qs_integral_new_from_string( const char* s ) {
 	if( !power_end || strlen( s )<6 )
 		return NULL;
 
-	QsIntegral result = malloc( sizeof (struct QsIntegral) );
+	unsigned n_powers = parse_powers( power_end,NULL );
+	QsIntegral result = malloc( qs_integral_footprint( n_powers ) );
 
 	result->prototype = strtoul( prototype_str,NULL,0 );
-	result->n_powers = 0;
-	result->powers = malloc( 0 );
+	result->n_powers = parse_powers( power_end,result->powers );
 
-	const char* power_base;
-	do {
-		power_base = power_end;
-		long value = strtol( power_base+1,&power_end,0 );
-		if( power_end!=power_base+1 ) {
-			result->powers = realloc( result->powers,( result->n_powers+1 )*sizeof (QsPower) );
-			result->powers[ result->n_powers++ ]= value;
+	return result;
+}
+
+/** Value of a digit in any base up to 16
+ *
+ * @param Character
+ * @return Value of the digit or 16 if the character is none
+ */
+static unsigned digit_value( char c ) {
+	if( c>='0' && c<='9' )
+		return c - '0';
+	if( c>='a' && c<='f' )
+		return c - 'a' + 10;
+	if( c>='A' && c<='F' )
+		return c - 'A' + 10;
+
+	return 16;
+}
+
+/** Parse an unsigned number in place
+ *
+ * Accepts the same as strtoul with base 0, i.e. hexadecimal numbers
+ * with a leading "0x" and octal numbers with a leading "0", but no
+ * sign or whitespace. Digits are no longer accumulated once the value
+ * exceeds the limit.
+ *
+ * @param[in,out] Beginning of the number, set to the first character
+ * not parsed
+ * @param End of the string
+ * @param Largest acceptable value
+ * @param[out] Value
+ * @return Whether there were digits and the value is within the limit
+ */
+static bool parse_number( const char** s,const char* end,unsigned long limit,unsigned long* value ) {
+	const char* p = *s;
+
+	unsigned base = 10;
+	if( p!=end && *p=='0' ) {
+		base = 8;
+		if( end - p>2 &&( p[ 1 ]=='x' || p[ 1 ]=='X' )&& digit_value( p[ 2 ] )<16 ) {
+			base = 16;
+			p += 2;
 		}
-	} while( power_end!=power_base+1 );
+	}
 
-	return result;
+	const char* digits = p;
+	bool within = true;
+	unsigned long result = 0;
+
+	unsigned digit;
+	for( ; p!=end &&( digit = digit_value( *p ) )<base; p++ ) {
+		if( digit>limit || result>( limit - digit )/base )
+			within = false;
+
+		if( within )
+			result = base*result + digit;
+	}
+
+	*s = p;
+	*value = result;
+
+	return p!=digits && within;
 }
 
-QsIntegral qs_integral_new_from_binary( const char* data,size_t len ) {
-	QsIntegral result = malloc( sizeof (struct QsIntegral) );
+static bool is_blank( char c ) {
+	return c==' ' || c=='\t' || c=='\r';
+}
 
-	char* powers_base;
-	result->prototype = strtoul( data+2,&powers_base,0 );
-	result->n_powers = 0;
-	result->powers = malloc( 0 );
-
-	QsPower* current_power = (QsPower*)( powers_base+1 );
-	QsPower* beyond_last = (QsPower*)( data+len );
-	while( current_power<beyond_last ) {
-		result->powers = realloc( result->powers,( result->n_powers+1 )*sizeof (QsPower) );
-		result->powers[ result->n_powers++ ]= *( current_power++ );
+static const char* skip_blanks( const char* s,const char* end ) {
+	while( s!=end && is_blank( *s ) )
+		s++;
+
+	return s;
+}
+
+/** Parse a string representation in place
+ *
+ * Strictly parses "PR<prototype>(<power>,...)" from the given range,
+ * allowing whitespace around the integral, before the parenthesis and
+ * around each power, without allocating. The range need
+ * not be terminated. Numbers may be given in decimal, octal or
+ * hexadecimal as for strtol.
+ *
+ * @param Beginning of the string
+ * @param End of the string
+ * @param[out] Prototype
+ * @param[out] Number of powers
+ * @param[out] Powers, must provide space for at least one more power
+ * than there are commas in the string
+ * @return Whether the string was a valid integral
+ */
+bool qs_integral_parse( const char* s,const char* end,QsPrototype* prototype,unsigned* n_powers,QsPower* powers ) {
+	s = skip_blanks( s,end );
+	while( end!=s && is_blank( end[ -1 ] ) )
+		end--;
+
+	if( end - s<5 || s[ 0 ]!='P' || s[ 1 ]!='R' || end[ -1 ]!=')' )
+		return false;
+
+	s += 2;
+	end--;
+
+	unsigned long p;
+	if( !parse_number( &s,end,(QsPrototype)-1,&p ) )
+		return false;
+
+	s = skip_blanks( s,end );
+	if( s==end || *s!='(' )
+		return false;
+
+	*prototype = p;
+	*n_powers = 0;
+
+	s = skip_blanks( s + 1,end );
+	while( s!=end ) {
+		bool negative = false;
+		if( *s=='-' || *s=='+' )
+			negative = *s++=='-';
+
+		unsigned long magnitude;
+		if( !parse_number( &s,end,negative ? POWER_MAX + 1 : POWER_MAX,&magnitude ) )
+			return false;
+
+		powers[ ( *n_powers )++ ]= negative && magnitude ? -(QsPower)( magnitude - 1 )- 1 : (QsPower)magnitude;
+
+		s = skip_blanks( s,end );
+		if( s!=end ) {
+			if( *s!=',' )
+				return false;
+
+			s = skip_blanks( s + 1,end );
+			if( s==end )
+				return false;
+		}
 	}
 
+	return true;
+}
+
+QsIntegral qs_integral_new_from_binary( const char* data,size_t len ) {
+	char* powers_base;
+	QsPrototype prototype = strtoul( data+2,&powers_base,0 );
+	unsigned n_powers =( data + len -( powers_base + 1 ) )/sizeof (QsPower);
+
+	QsIntegral result = malloc( qs_integral_footprint( n_powers ) );
+	result->prototype = prototype;
+	result->n_powers = n_powers;
+	memcpy( result->powers,powers_base + 1,n_powers*sizeof (QsPower) );
+
+	return result;
+}
+
+/** Size of an integral record
+ *
+ * The number of bytes an integral with the given number of powers
+ * occupies, rounded up such that records may be placed back to back.
+ *
+ * @param Number of powers
+ * @return Size in bytes
+ */
+size_t qs_integral_footprint( unsigned n_powers ) {
+	const size_t align = _Alignof (struct QsIntegral);
+	size_t size = sizeof (struct QsIntegral) + n_powers*sizeof (QsPower);
+
+	return ( size + align - 1 )/align*align;
+}
+
+/** Construct an integral in given memory
+ *
+ * The memory must be at least qs_integral_footprint( n ) bytes and
+ * suitably aligned. The result must not be passed to
+ * qs_integral_destroy, the memory remains the caller's.
+ *
+ * @param Memory to construct the integral in
+ * @param Prototype
+ * @param Number of powers
+ * @param Powers
+ * @return The integral
+ */
+QsIntegral qs_integral_new_in_place( void* memory,QsPrototype prototype,unsigned n_powers,const QsPower* powers ) {
+	QsIntegral result = memory;
+	result->prototype = prototype;
+	result->n_powers = n_powers;
+	memcpy( result->powers,powers,n_powers*sizeof (QsPower) );
+
 	return result;
 }
 
@@ -65,58 +260,123 @@ size_t qs_integral_to_binary( QsIntegral i,char** out ) {
 	return prot_len + 1 + i->n_powers*sizeof (QsPower);
 }
 
-/** Print string representation of integral
+static size_t format_long( char* b,long value ) {
+	char digits[ 3*sizeof (long) ];
+	unsigned long magnitude = value<0?-(unsigned long)value:value;
+
+	size_t n = 0;
+	do {
+		digits[ n++ ]= '0' + magnitude%10;
+		magnitude /= 10;
+	} while( magnitude );
+
+	size_t len = 0;
+	if( value<0 )
+		b[ len++ ]= '-';
+
+	while( n )
+		b[ len++ ]= digits[ --n ];
+
+	return len;
+}
+
+/** Upper bound of the length of a string representation
  *
- * Prints an integral as a string
+ * @param This
+ * @return Number of bytes which suffice for qs_integral_format
+ */
+size_t qs_integral_format_size( const QsIntegral i ) {
+	return 3 + 3*sizeof (QsPrototype)+( i->n_powers + 1 )*( 2 + 3*sizeof (QsPower) );
+}
+
+/** Write string representation of integral
+ *
+ * Writes an integral as a string into the given memory without
+ * allocation. The result is not terminated.
  *
  * @param This
- * @param[callee-allocates] Pointer to string
+ * @param Memory of at least qs_integral_format_size bytes
  * @return Length of written string
  */
-size_t qs_integral_print( const QsIntegral i,char** b ) {
-	int len = asprintf( b,"PR%u(",i->prototype );
+size_t qs_integral_format( const QsIntegral i,char* b ) {
+	size_t len = 2;
+	b[ 0 ]= 'P';
+	b[ 1 ]= 'R';
+
+	len += format_long( b + len,i->prototype );
+	b[ len++ ]= '(';
 
 	int j;
 	for( j = 0; j<i->n_powers; j++ ) {
-		char* result;
-		int got = asprintf( &result,"%hhi,",i->powers[ j ] );
+		if( j )
+			b[ len++ ]= ',';
+		len += format_long( b + len,i->powers[ j ] );
+	}
 
-		*b = realloc( *b,len+got+1 );
+	b[ len++ ]= ')';
 
-		strcpy( *b+len,result );
-		free( result );
-		len += got;
-	}
+	return len;
+}
 
-	( *b )[ len-1 ]= ')';
+/** Print string representation of integral
+ *
+ * Prints an integral as a string
+ *
+ * @param This
+ * @param[callee-allocates] Pointer to string
+ * @return Length of written string
+ */
+size_t qs_integral_print( const QsIntegral i,char** b ) {
+	*b = malloc( qs_integral_format_size( i )+ 1 );
+
+	size_t len = qs_integral_format( i,*b );
+	( *b )[ len ]= '\0';
 
 	return len;
 }
 
 bool qs_integral_cmp( const QsIntegral i1,const QsIntegral i2 ) {
-	if( i1->prototype!=i2->prototype || i1->n_powers!=i2->n_powers )
-		return true;
+	return i1->prototype!=i2->prototype || i1->n_powers!=i2->n_powers || memcmp( i1->powers,i2->powers,i1->n_powers*sizeof (QsPower) );
+}
+
+/** Hash of an integral
+ *
+ * FNV-1a over the prototype and the powers. Integrals which compare
+ * equal under qs_integral_cmp have equal hashes.
+ *
+ * @param This
+ * @return The hash value
+ */
+unsigned long qs_integral_hash( const QsIntegral i ) {
+	return qs_integral_hash_powers( i->prototype,i->n_powers,i->powers );
+}
+
+/** Hash of prototype and powers
+ *
+ * Same as qs_integral_hash for an integral with the given data, without
+ * the need to construct it.
+ */
+unsigned long qs_integral_hash_powers( QsPrototype prototype,unsigned n_powers,const QsPower* powers ) {
+	unsigned long result = INTEGRAL_HASH_OFFSET;
+
+	result =( result^prototype )*INTEGRAL_HASH_PRIME;
 
 	int j;
-	for( j = 0; j<i1->n_powers; j++ )
-		if( i1->powers[ j ]!=i2->powers[ j ] )
-			return true;
+	for( j = 0; j<n_powers; j++ )
+		result =( result^(unsigned long)powers[ j ] )*INTEGRAL_HASH_PRIME;
 
-	return false;
+	return result;
 }
 
 QsIntegral qs_integral_cpy( const QsIntegral i ) {
-	QsIntegral result = malloc( sizeof (struct QsIntegral) );
-	result->prototype = i->prototype;
-	result->n_powers = i->n_powers;
-	result->powers = malloc( i->n_powers*sizeof (QsPower) );
-	memcpy( result->powers,i->powers,i->n_powers*sizeof( QsPower) );
+	size_t size = qs_integral_footprint( i->n_powers );
+	QsIntegral result = malloc( size );
+	memcpy( result,i,size );
 
 	return result;
 }
 
 void qs_integral_destroy( QsIntegral i ) {
-	free( i->powers );
 	free( i );
 }
 
@@ -7,9 +7,16 @@ typedef struct QsIntegral* QsIntegral;
 
 QsIntegral qs_integral_new_from_string( const char* );
 QsIntegral qs_integral_new_from_binary( const char*,size_t );
+bool qs_integral_parse( const char*,const char*,QsPrototype*,unsigned*,QsPower* );
+QsIntegral qs_integral_new_in_place( void*,QsPrototype,unsigned,const QsPower* );
+size_t qs_integral_footprint( unsigned );
 size_t qs_integral_print( const QsIntegral,char** );
+size_t qs_integral_format( const QsIntegral,char* );
+size_t qs_integral_format_size( const QsIntegral );
 size_t qs_integral_to_binary( QsIntegral i,char** out );
 bool qs_integral_cmp( const QsIntegral,const QsIntegral );
+unsigned long qs_integral_hash( const QsIntegral );
+unsigned long qs_integral_hash_powers( QsPrototype,unsigned,const QsPower* );
 QsIntegral qs_integral_cpy( const QsIntegral );
 const QsPower* qs_integral_powers( const QsIntegral );
 unsigned qs_integral_n_powers( const QsIntegral );
@@ -6,13 +6,42 @@
 #include <string.h>
 #include <assert.h>
 #include <stdio.h>
+#include <limits.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include "db.h"
 
-struct Target {
-	QsIntegral integral;
-	bool master;
+#define INDEX_EMPTY ( (QsComponent)-1 )
+#define INDEX_MIN_SIZE 64
+#define INDEX_SHARD_BITS 6
+#define INDEX_SHARDS ( 1<<INDEX_SHARD_BITS )
+#define INDEX_SHARD( h ) ( (h)>>( CHAR_BIT*sizeof (unsigned long) - INDEX_SHARD_BITS ) )
+#define ARENA_BLOCK 4096
+#define PAGE_BITS 16
+#define PAGE_SIZE ( 1<<PAGE_BITS )
+#define N_PAGES ( ( (size_t)(QsComponent)-1 >>PAGE_BITS )+ 1 )
+#define MASTER_BITS ( CHAR_BIT*sizeof (unsigned long) )
+#define ORDER_KNOWN ( 1ULL<<32 )
+#define ORDER_SOLVED ( 1ULL<<33 )
+#define ORDER_TOUCHED ( 1ULL<<34 )
+
+/** Interning arena
+ *
+ * Holds the integrals of one prototype with a given number of powers
+ * as fixed size records back to back. Records are allocated in blocks
+ * of ARENA_BLOCK which are never moved, such that the QsIntegrals
+ * handed out by qs_integral_mgr_peek stay valid.
+ */
+struct Arena {
+	unsigned n_powers;
+	size_t stride;
+
+	unsigned n_blocks;
+	unsigned n_used; ///< Number of records used in the last block
+	char** blocks;
+
+	struct Arena* next; ///< Arena of the same prototype with a different number of powers
 };
 
 struct Databases {
@@ -20,15 +49,58 @@ struct Databases {
 	QsDb readwrite;
 };
 
-struct Substitution {
-	char* name;
-	char* value;
+/** State of a prototype
+ *
+ * Everything specific to one prototype is guarded by the sector's own
+ * lock, so that integrals of different prototypes are interned and
+ * their databases opened without contention. */
+struct Sector {
+	pthread_mutex_t lock;
+
+	struct Arena* arenas;
+
+	bool opened; ///< Whether opening the databases was attempted
+	struct Databases dbs;
+};
+
+/** Page of the component table
+ *
+ * Pages are allocated on demand and never moved, such that readers
+ * need no lock to look up components they have been given. */
+struct Page {
+	QsIntegral integrals[ PAGE_SIZE ];
+	_Atomic unsigned long masters[ PAGE_SIZE/MASTER_BITS ]; ///< Bitset of components known to be master integrals
+	_Atomic unsigned long long orders[ PAGE_SIZE ]; ///< Metadata index, order in the low 32 bits and ORDER_* flags
 };
 
+/** Shard of the integral index
+ *
+ * Open addressing hash table mapping integrals to components by linear
+ * probing. The size is a power of two and kept at least twice
+ * n_entries. Empty slots are INDEX_EMPTY. Integrals are distributed
+ * over the shards by the high bits of their hash. */
+struct Shard {
+	pthread_mutex_t lock;
+
+	size_t n_entries;
+	size_t size;
+	QsComponent* slots;
+};
+
+/** Integral manager
+ *
+ * All functions but qs_integral_mgr_add_substitution and
+ * qs_integral_mgr_destroy may be called concurrently.
+ */
 struct QsIntegralMgr {
-	unsigned n_integrals;
-	unsigned allocated;
-	struct Target* integrals;
+	_Atomic QsComponent n_integrals;
+	_Atomic (struct Page*)* pages; ///< Component table of N_PAGES pages
+
+	struct Shard index[ INDEX_SHARDS ];
+
+	pthread_rwlock_t sectors_lock; ///< Guards growth of sectors
+	unsigned n_sectors;
+	struct Sector** sectors; ///< Sectors by prototype
 
 	char* ro_prefix;
 	char* ro_suffix;
@@ -36,45 +108,230 @@ struct QsIntegralMgr {
 	char* rw_prefix;
 	char* rw_suffix;
 
-	unsigned n_dbs;
-	struct Databases** dbs;
-
-	unsigned n_substitutions;
-	struct Substitution* substitutions;
+	QsSubstitution substitutions;
 };
 
-static struct Databases open_db( QsIntegralMgr m,QsPrototype p,bool create_rw ) {
-	if( !( p<m->n_dbs ) ) {
-		m->dbs = realloc( m->dbs,( p + 1 )*sizeof (struct Databases*) );
+static size_t index_size_for( size_t n ) {
+	size_t result = INDEX_MIN_SIZE;
+	while( result<2*n )
+		result <<= 1;
+
+	return result;
+}
+
+static struct Page* page_of( QsIntegralMgr m,QsComponent i ) {
+	return atomic_load_explicit( m->pages + ( i>>PAGE_BITS ),memory_order_acquire );
+}
+
+static QsIntegral integral_of( QsIntegralMgr m,QsComponent i ) {
+	return page_of( m,i )->integrals[ i&( PAGE_SIZE - 1 ) ];
+}
+
+/** Find the slot of an integral
+ *
+ * The shard's lock must be held.
+ *
+ * @param This
+ * @param The shard to search
+ * @param Hash of the integral to look for
+ * @param Prototype of the integral
+ * @param Number of powers of the integral
+ * @param Powers of the integral
+ * @return The slot containing the integral's component or the empty
+ * slot at which it is to be inserted
+ */
+static size_t index_slot( QsIntegralMgr m,struct Shard* shard,unsigned long hash,QsPrototype p,unsigned n_powers,const QsPower* powers ) {
+	size_t mask = shard->size - 1;
+	size_t slot = hash&mask;
+
+	QsComponent c;
+	while( ( c = shard->slots[ slot ] )!=INDEX_EMPTY ) {
+		QsIntegral candidate = integral_of( m,c );
+
+		if( qs_integral_prototype( candidate )==p && qs_integral_n_powers( candidate )==n_powers && !memcmp( qs_integral_powers( candidate ),powers,n_powers*sizeof (QsPower) ) )
+			break;
+
+		slot =( slot + 1 )&mask;
+	}
+
+	return slot;
+}
+
+static void index_grow( QsIntegralMgr m,struct Shard* shard ) {
+	size_t old_size = shard->size;
+	QsComponent* old_slots = shard->slots;
+
+	shard->size <<= 1;
+	shard->slots = malloc( shard->size*sizeof (QsComponent) );
+
+	size_t mask = shard->size - 1;
+
+	size_t j;
+	for( j = 0; j<shard->size; j++ )
+		shard->slots[ j ]= INDEX_EMPTY;
+
+	for( j = 0; j<old_size; j++ )
+		if( old_slots[ j ]!=INDEX_EMPTY ) {
+			size_t slot = qs_integral_hash( integral_of( m,old_slots[ j ] ) )&mask;
+			while( shard->slots[ slot ]!=INDEX_EMPTY )
+				slot =( slot + 1 )&mask;
+
+			shard->slots[ slot ]= old_slots[ j ];
+		}
+
+	free( old_slots );
+}
+
+/** Obtain the sector of a prototype
+ *
+ * @param This
+ * @param The prototype
+ * @return The sector, created if necessary
+ */
+static struct Sector* sector_of( QsIntegralMgr m,QsPrototype p ) {
+	struct Sector* result = NULL;
+
+	pthread_rwlock_rdlock( &m->sectors_lock );
+	if( p<m->n_sectors )
+		result = m->sectors[ p ];
+	pthread_rwlock_unlock( &m->sectors_lock );
+
+	if( !result ) {
+		pthread_rwlock_wrlock( &m->sectors_lock );
+
+		if( !( p<m->n_sectors ) ) {
+			m->sectors = realloc( m->sectors,( p + 1 )*sizeof (struct Sector*) );
+			int j;
+			for( j = m->n_sectors; j<p + 1; j++ )
+				m->sectors[ j ]= NULL;
+			m->n_sectors = p + 1;
+		}
+
+		if( !( result = m->sectors[ p ] ) ) {
+			result = m->sectors[ p ]= malloc( sizeof (struct Sector) );
+			pthread_mutex_init( &result->lock,NULL );
+			result->arenas = NULL;
+			result->opened = false;
+			result->dbs = (struct Databases){ NULL,NULL };
+		}
+
+		pthread_rwlock_unlock( &m->sectors_lock );
+	}
+
+	return result;
+}
+
+/** Copy an integral into its arena
+ *
+ * @param This
+ * @param Prototype
+ * @param Number of powers
+ * @param Powers
+ * @return The interned integral, owned by the QsIntegralMgr
+ */
+static QsIntegral arena_intern( QsIntegralMgr m,QsPrototype p,unsigned n_powers,const QsPower* powers ) {
+	struct Sector* sector = sector_of( m,p );
+
+	pthread_mutex_lock( &sector->lock );
+
+	struct Arena** a = &sector->arenas;
+	while( *a &&( *a )->n_powers!=n_powers )
+		a = &( *a )->next;
+
+	if( !*a ) {
+		*a = malloc( sizeof (struct Arena) );
+		( *a )->n_powers = n_powers;
+		( *a )->stride = qs_integral_footprint( n_powers );
+		( *a )->n_blocks = 0;
+		( *a )->n_used = ARENA_BLOCK;
+		( *a )->blocks = malloc( 0 );
+		( *a )->next = NULL;
+	}
+
+	struct Arena* arena = *a;
+
+	if( arena->n_used==ARENA_BLOCK ) {
+		arena->blocks = realloc( arena->blocks,( arena->n_blocks + 1 )*sizeof (char*) );
+		arena->blocks[ arena->n_blocks++ ]= malloc( ARENA_BLOCK*arena->stride );
+		arena->n_used = 0;
+	}
+
+	char* record = arena->blocks[ arena->n_blocks - 1 ]+( arena->n_used++ )*arena->stride;
+
+	pthread_mutex_unlock( &sector->lock );
+
+	return qs_integral_new_in_place( record,p,n_powers,powers );
+}
+
+static void arena_destroy( struct Arena* a ) {
+	while( a ) {
+		struct Arena* next = a->next;
+
 		int j;
-		for( j = m->n_dbs; j<p + 1; j++ )
-			m->dbs[ j ]= NULL;
-		m->n_dbs = p + 1;
+		for( j = 0; j<a->n_blocks; j++ )
+			free( a->blocks[ j ] );
+
+		free( a->blocks );
+		free( a );
+
+		a = next;
 	}
+}
+
+static struct Databases open_db( QsIntegralMgr m,QsPrototype p,bool create_rw ) {
+	struct Sector* sector = sector_of( m,p );
+
+	pthread_mutex_lock( &sector->lock );
 
 	bool new;
-	if( ( new = !m->dbs[ p ] ) ) {
-		m->dbs[ p ]= malloc( sizeof (struct Databases) );
+	if( ( new = !sector->opened ) ) {
+		sector->opened = true;
 
 		char* filename;
 		asprintf( &filename,"%s%i%s",m->ro_prefix,p,m->ro_suffix );
-		m->dbs[ p ]->read = qs_db_new( filename,QS_DB_READ );
+		sector->dbs.read = qs_db_new( filename,QS_DB_READ );
 		free( filename );
 	}
 
-	if( new || ( !m->dbs[ p ]->readwrite && create_rw ) ) {
+	if( new || ( !sector->dbs.readwrite && create_rw ) ) {
 		char* filename;
 		asprintf( &filename,"%s%i%s",m->rw_prefix,p,m->rw_suffix );
-		m->dbs[ p ]->readwrite = qs_db_new( filename,QS_DB_WRITE|( create_rw?QS_DB_CREATE:0 ) );
+		sector->dbs.readwrite = qs_db_new( filename,QS_DB_WRITE|( create_rw?QS_DB_CREATE:0 ) );
 		free( filename );
 	}
 
-	return *( m->dbs[ p ] );
+	struct Databases result = sector->dbs;
+
+	pthread_mutex_unlock( &sector->lock );
+
+	return result;
+}
+
+/** Synchronize solution databases
+ *
+ * Writes all identities saved so far through to disk.
+ *
+ * @param This
+ */
+void qs_integral_mgr_sync( QsIntegralMgr m ) {
+	pthread_rwlock_rdlock( &m->sectors_lock );
+
+	int j;
+	for( j = 0; j<m->n_sectors; j++ )
+		if( m->sectors[ j ] ) {
+			pthread_mutex_lock( &m->sectors[ j ]->lock );
+
+			if( m->sectors[ j ]->dbs.readwrite )
+				qs_db_sync( m->sectors[ j ]->dbs.readwrite );
+
+			pthread_mutex_unlock( &m->sectors[ j ]->lock );
+		}
+
+	pthread_rwlock_unlock( &m->sectors_lock );
 }
 
 void qs_integral_mgr_add_substitution( QsIntegralMgr m,char* symbol,char* value ) {
-	m->substitutions = realloc( m->substitutions,++( m->n_substitutions )*sizeof (struct Substitution) );
-	m->substitutions[ m->n_substitutions - 1 ]= (struct Substitution){ strdup( symbol ),strdup( value ) };
+	qs_substitution_add( m->substitutions,symbol,value );
 }
 
 /** Load and save
@@ -135,6 +392,12 @@ void qs_integral_mgr_add_substitution( QsIntegralMgr m,char* symbol,char* value
  * is associated. * 
  */
 
+static void index_meta( QsIntegralMgr m,QsComponent i,const struct QsMetadata* meta ) {
+	unsigned long long packed = meta->order | ORDER_KNOWN |( meta->solved?ORDER_SOLVED:0 )|( meta->touched?ORDER_TOUCHED:0 );
+
+	atomic_store_explicit( page_of( m,i )->orders +( i&( PAGE_SIZE - 1 ) ),packed,memory_order_relaxed );
+}
+
 void qs_integral_mgr_save_expression( QsIntegralMgr m,QsComponent i,struct QsReflist l,struct QsMetadata meta ) {
 	QsExpression e = qs_expression_new_with_size( meta.solved?l.n_references - 1:l.n_references );
 
@@ -173,12 +436,61 @@ void qs_integral_mgr_save_expression( QsIntegralMgr m,QsComponent i,struct QsRef
 	qs_db_entry_destroy( entry );
 
 	qs_expression_disband( e );
+
+	index_meta( m,i,&meta );
 }
 
-QsExpression qs_integral_mgr_load_raw( QsIntegralMgr m,QsIntegral in,struct QsMetadata* meta ) {
-	QsExpression result = NULL;
-	bool sub_self = false;
+/** Decode metadata of a solution database entry
+ *
+ * @param The entry
+ *
+ * @param Extent of the expression within the entry
+ *
+ * @param[out] Metadata
+ *
+ * @return Whether the entry carried metadata, otherwise it is a solution
+ * stored by IdSolver
+ */
+static bool decode_meta( const struct QsDbEntry* data,unsigned n,struct QsMetadata* meta ) {
+	if( data->vallen>=n+QS_METADATA_SIZE ) {
+		meta->order = *( (int*)( data->val + n ) );
+		meta->consideration = *( (short*)( data->val + n + sizeof (int) ) );
+		char flags = *( (char*)( data->val + n + sizeof (int) + sizeof (short) ) );
+
+		meta->solved = flags&1;
+		meta->touched = flags&2;
+
+		return true;
+	} else {
+		meta->order = 0;
+		meta->consideration = 0;
+		meta->solved = true;
+		meta->touched = false;
+
+		return false;
+	}
+}
 
+/** Fetch the database entry of an identity
+ *
+ * Looks up the identity of an integral in the solution database and
+ * then in the identity database and determines its metadata without
+ * decoding the expression.
+ *
+ * @param This
+ *
+ * @param Integral
+ *
+ * @param[out] Metadata
+ *
+ * @param[out] Extent of the expression within the entry
+ *
+ * @param[out] Whether -1 times the integral itself is implied in
+ * addition to the stored expression
+ *
+ * @return The entry or NULL if there is none
+ */
+static struct QsDbEntry* fetch_entry( QsIntegralMgr m,QsIntegral in,struct QsMetadata* meta,unsigned* extent,bool* sub_self ) {
 	struct Databases dbs = open_db( m,qs_integral_prototype( in ),false );
 
 	unsigned n_powers = qs_integral_n_powers( in );
@@ -188,48 +500,52 @@ QsExpression qs_integral_mgr_load_raw( QsIntegralMgr m,QsIntegral in,struct QsMe
 
 	if( dbs.readwrite &&( data = qs_db_get( dbs.readwrite,(char*)pwrs,keylen ) ) ) {
 		/* Obtain identity from solution database */
-		unsigned n;
-		result = qs_expression_new_from_binary( data->val,data->vallen,&n );
-
-		if( data->vallen>=n+QS_METADATA_SIZE ) {
-			meta->order = *( (int*)( data->val + n ) );
-			meta->consideration = *( (short*)( data->val + n + sizeof (int) ) );
-			char flags = *( (char*)( data->val + n + sizeof (int) + sizeof (short) ) );
-
-			meta->solved = flags&1;
-			meta->touched = flags&2;
-		} else {
-			meta->order = 0;
-			meta->consideration = 0;
-			meta->solved = true;
-			meta->touched = false;
-
-			sub_self = true;
-		}
-
-		qs_db_entry_destroy( data );
+		*extent = qs_expression_binary_extent( data->val,data->vallen );
+		*sub_self = !decode_meta( data,*extent,meta );
 	} else if( dbs.read &&( data = qs_db_get( dbs.read,(char*)pwrs,keylen ) ) ) {
 		/* Obtain identity from identity database */
-		result = qs_expression_new_from_binary( data->val,data->vallen,NULL );
+		*extent = qs_expression_binary_extent( data->val,data->vallen );
 		meta->order = *( (int*)( data->val + data->vallen - sizeof (int) ) );
-		meta->consideration = 0;
 		meta->solved = false;
 		meta->touched = false;
 
-		if( result )
-			if( qs_expression_n_terms( result )==1 && qs_coefficient_is_one( qs_expression_coefficient( result,0 ) ) )
-				sub_self = true;
+		/* A single term with coefficient 1 */
+		*sub_self = false;
+		if( *extent ) {
+			int len_integral = *( (int*)data->val );
+			int len_coefficient = *( (int*)( data->val + sizeof (int) + len_integral ) );
+			const char* coefficient = data->val + 2*sizeof (int) + len_integral;
 
-		qs_db_entry_destroy( data );
+			if( *extent==len_integral + len_coefficient + 2*sizeof (int) && len_coefficient>0 && coefficient[ 0 ]=='1' &&( len_coefficient==1 || coefficient[ 1 ]=='\0' ) )
+				*sub_self = true;
+		}
 	} else
-		return result;
+		return NULL;
 
 	/* TODO: Discarding the number of considerations on write back
 	 * operations for memory reduction has side effects when we are in a
 	 * desperate back substitutions. */
 	meta->consideration = 0;
 
-	if( qs_expression_n_terms( result )==0 || sub_self )
+	if( *extent==0 )
+		*sub_self = true;
+
+	return data;
+}
+
+QsExpression qs_integral_mgr_load_raw( QsIntegralMgr m,QsIntegral in,struct QsMetadata* meta ) {
+	unsigned extent;
+	bool sub_self;
+	struct QsDbEntry* data = fetch_entry( m,in,meta,&extent,&sub_self );
+
+	if( !data )
+		return NULL;
+
+	QsExpression result = qs_expression_new_from_binary( data->val,extent,NULL );
+
+	qs_db_entry_destroy( data );
+
+	if( sub_self )
 		qs_expression_add( result,qs_coefficient_one( true ),qs_integral_cpy( in ) );
 
 	return result;
@@ -238,13 +554,16 @@ QsExpression qs_integral_mgr_load_raw( QsIntegralMgr m,QsIntegral in,struct QsMe
 struct QsReflist qs_integral_mgr_load_expression( QsIntegralMgr m,QsComponent i,struct QsMetadata* meta ) {
 	struct QsReflist result ={ 0,NULL };
 
-	if( m->integrals[ i ].master )
+	_Atomic unsigned long* masters = page_of( m,i )->masters +( i&( PAGE_SIZE - 1 ) )/MASTER_BITS;
+	unsigned long master_bit = 1UL<<( i%MASTER_BITS );
+
+	if( atomic_load_explicit( masters,memory_order_relaxed )&master_bit )
 		return result;
 
-	QsExpression e = qs_integral_mgr_load_raw( m,m->integrals[ i ].integral,meta );
+	QsExpression e = qs_integral_mgr_load_raw( m,integral_of( m,i ),meta );
 	
 	if( !e ) {
-		m->integrals[ i ].master = true;
+		atomic_fetch_or_explicit( masters,master_bit,memory_order_relaxed );
 		return result;
 	}
 
@@ -256,104 +575,269 @@ struct QsReflist qs_integral_mgr_load_expression( QsIntegralMgr m,QsComponent i,
 		QsIntegral integral = qs_expression_integral( e,j );
 		QsCoefficient coefficient = qs_expression_coefficient( e,j );
 
-		int k;
-		for( k = 0; k<m->n_substitutions; k++ )
-			qs_coefficient_substitute( coefficient,m->substitutions[ k ].name,m->substitutions[ k ].value );
+		qs_coefficient_substitute( coefficient,m->substitutions );
 
 		result.references[ j ].coefficient = coefficient;
 		result.references[ j ].head = qs_integral_mgr_manage( m,integral );
 	}
 
 	qs_expression_disband( e );
+
+	index_meta( m,i,meta );
 	
 	return result;
 }
 
+/** Load metadata of an identity
+ *
+ * Determines the metadata which qs_integral_mgr_load_expression would
+ * yield without decoding the identity. Metadata are kept in an index
+ * once determined and updated whenever an identity is saved.
+ *
+ * @param This
+ *
+ * @param Component
+ *
+ * @param[out] Metadata
+ *
+ * @return Whether there is an identity for the component, false for
+ * master integrals
+ */
+bool qs_integral_mgr_load_meta( QsIntegralMgr m,QsComponent i,struct QsMetadata* meta ) {
+	struct Page* page = page_of( m,i );
+	_Atomic unsigned long* masters = page->masters +( i&( PAGE_SIZE - 1 ) )/MASTER_BITS;
+	unsigned long master_bit = 1UL<<( i%MASTER_BITS );
+
+	if( atomic_load_explicit( masters,memory_order_relaxed )&master_bit )
+		return false;
+
+	unsigned long long packed = atomic_load_explicit( page->orders +( i&( PAGE_SIZE - 1 ) ),memory_order_relaxed );
+
+	if( !( packed&ORDER_KNOWN ) ) {
+		unsigned extent;
+		bool sub_self;
+		struct QsDbEntry* data = fetch_entry( m,integral_of( m,i ),meta,&extent,&sub_self );
+
+		if( !data ) {
+			atomic_fetch_or_explicit( masters,master_bit,memory_order_relaxed );
+			return false;
+		}
+
+		qs_db_entry_destroy( data );
+
+		index_meta( m,i,meta );
+
+		return true;
+	}
+
+	meta->order = (unsigned)packed;
+	meta->consideration = 0;
+	meta->solved = packed&ORDER_SOLVED;
+	meta->touched = packed&ORDER_TOUCHED;
+
+	return true;
+}
+
+/** Load a single coefficient of an identity
+ *
+ * Yields the coefficient which qs_integral_mgr_load_expression would
+ * yield for the given head, but only decodes and substitutes that one
+ * coefficient.
+ *
+ * @param This
+ *
+ * @param Component whose identity is loaded
+ *
+ * @param Component of the head whose coefficient is loaded
+ *
+ * @return The coefficient or NULL if the identity has no such head
+ */
+QsCoefficient qs_integral_mgr_load_coefficient( QsIntegralMgr m,QsComponent tail,QsComponent head ) {
+	struct QsMetadata meta;
+	unsigned extent;
+	bool sub_self;
+	struct QsDbEntry* data = fetch_entry( m,integral_of( m,tail ),&meta,&extent,&sub_self );
+
+	if( !data )
+		return NULL;
+
+	QsCoefficient result = NULL;
+
+	/* The implied term comes last and takes precedence like on a full
+	 * load into the pivot graph */
+	if( sub_self && head==tail )
+		result = qs_coefficient_one( true );
+	else {
+		char* key;
+		size_t keylen = qs_integral_to_binary( integral_of( m,head ),&key );
+
+		unsigned c = 0;
+		while( !result && c +( 2*sizeof (int)-1 )<extent ) {
+			const char* base = data->val + c;
+			int len_integral = *( (int*)base );
+			int len_coefficient = *( (int*)( base + sizeof (int)+ len_integral ) );
+
+			if( len_integral==keylen && !memcmp( base + sizeof (int),key,keylen ) )
+				result = qs_coefficient_new_from_binary( base + 2*sizeof (int)+ len_integral,len_coefficient );
+
+			c += len_integral + len_coefficient + 2*sizeof (int);
+		}
+
+		free( key );
+	}
+
+	qs_db_entry_destroy( data );
+
+	if( result )
+		qs_coefficient_substitute( result,m->substitutions );
+
+	return result;
+}
+
 QsIntegral qs_integral_mgr_peek( QsIntegralMgr m,QsComponent i ) {
-	if( !( i<m->n_integrals ) )
+	if( !( i<atomic_load_explicit( &m->n_integrals,memory_order_acquire ) ) )
 		return NULL;
 
-	return m->integrals[ i ].integral;
+	/* Components which are still being managed concurrently yield NULL */
+	struct Page* page = page_of( m,i );
+
+	return page?page->integrals[ i&( PAGE_SIZE - 1 ) ]:NULL;
 }
 
 QsIntegralMgr qs_integral_mgr_new_with_size( const char* ro_prefix,const char* ro_suffix,const char* rw_prefix,const char* rw_suffix,unsigned prealloc ) {
 	QsIntegralMgr result = malloc( sizeof (struct QsIntegralMgr) );
-	result->n_integrals = 0;
-	result->allocated = prealloc;
-	result->integrals = malloc( prealloc*sizeof (struct Target) );
+	atomic_init( &result->n_integrals,0 );
+	result->pages = calloc( N_PAGES,sizeof (struct Page*) );
 	result->ro_prefix = strdup( ro_prefix );
 	result->ro_suffix = strdup( ro_suffix );
 	result->rw_prefix = strdup( rw_prefix );
 	result->rw_suffix = strdup( rw_suffix );
 
-	result->n_dbs = 0;
-	result->dbs = malloc( 0 );
+	int j;
+	for( j = 0; j<INDEX_SHARDS; j++ ) {
+		struct Shard* shard = result->index + j;
+
+		pthread_mutex_init( &shard->lock,NULL );
+		shard->n_entries = 0;
+		shard->size = index_size_for( prealloc/INDEX_SHARDS );
+		shard->slots = malloc( shard->size*sizeof (QsComponent) );
+
+		size_t k;
+		for( k = 0; k<shard->size; k++ )
+			shard->slots[ k ]= INDEX_EMPTY;
+	}
+
+	pthread_rwlock_init( &result->sectors_lock,NULL );
+	result->n_sectors = 0;
+	result->sectors = malloc( 0 );
 
-	result->n_substitutions = 0;
-	result->substitutions = malloc( 0 );
+	result->substitutions = qs_substitution_new( );
 
 	return result;
 }
 
+/** Manage an integral given by its data
+ *
+ * Looks up the integral with the given prototype and powers and
+ * interns it if it is not yet known. No QsIntegral needs to be
+ * constructed by the caller.
+ *
+ * @param This
+ * @param Prototype
+ * @param Number of powers
+ * @param[transfer none] Powers
+ * @return The uniquely assigned Id of the Integral
+ */
+QsComponent qs_integral_mgr_manage_powers( QsIntegralMgr g,QsPrototype p,unsigned n_powers,const QsPower* powers ) {
+	unsigned long hash = qs_integral_hash_powers( p,n_powers,powers );
+	struct Shard* shard = g->index + INDEX_SHARD( hash );
+
+	pthread_mutex_lock( &shard->lock );
+
+	size_t slot = index_slot( g,shard,hash,p,n_powers,powers );
+	QsComponent j = shard->slots[ slot ];
+
+	if( j==INDEX_EMPTY ) {
+		j = atomic_fetch_add_explicit( &g->n_integrals,1,memory_order_relaxed );
+		assert( j!=INDEX_EMPTY );
+
+		_Atomic (struct Page*)* page = g->pages +( j>>PAGE_BITS );
+		if( !atomic_load_explicit( page,memory_order_acquire ) ) {
+			struct Page* new = calloc( 1,sizeof (struct Page) );
+			struct Page* expected = NULL;
+
+			if( !atomic_compare_exchange_strong_explicit( page,&expected,new,memory_order_acq_rel,memory_order_acquire ) )
+				free( new );
+		}
+
+		atomic_load_explicit( page,memory_order_acquire )->integrals[ j&( PAGE_SIZE - 1 ) ]= arena_intern( g,p,n_powers,powers );
+
+		shard->slots[ slot ]= j;
+
+		if( 2*++( shard->n_entries )>shard->size )
+			index_grow( g,shard );
+	}
+
+	pthread_mutex_unlock( &shard->lock );
+
+	return j;
+}
+
 /** Take responsibility of the integral
  *
  * Takes ownership of the integral and will return a unique pointer to
- * that integral.
+ * that integral. The integral is interned into the QsIntegralMgr's
+ * arena and destroyed.
  *
  * @param This
  * @param[transfer full] The integral to manage
  * @return The uniquely assigned Id of the Integral
  */
 QsComponent qs_integral_mgr_manage( QsIntegralMgr g,QsIntegral i ) {
-	int j = 0;
-	while( j<g->n_integrals && qs_integral_cmp( g->integrals[ j ].integral,i ) )
-		j++;
-
-	if( j==g->n_integrals ) {
-		if( g->allocated==g->n_integrals )
-			g->integrals = realloc( g->integrals,++( g->allocated )*sizeof (struct Target) );
-		g->integrals[ j ].integral = i;
-		g->integrals[ j ].master = false;
-		g->n_integrals++;
-	} else {
-		/* If we're told to manage the very integral that we gave to you or
-		 * that you previously told us to manage, you're doing something
-		 * ugly */
-		assert( g->integrals[ j ].integral!=i );
-		qs_integral_destroy( i );
-	}
+	QsComponent result = qs_integral_mgr_manage_powers( g,qs_integral_prototype( i ),qs_integral_n_powers( i ),qs_integral_powers( i ) );
 
-	return j;
+	/* If we're told to manage the very integral that we gave to you, you're
+	 * doing something ugly */
+	assert( integral_of( g,result )!=i );
+	qs_integral_destroy( i );
+
+	return result;
 }
 
 void qs_integral_mgr_destroy( QsIntegralMgr m ) {
 	int j;
-	for( j = 0; j<m->n_integrals; j++ )
-		qs_integral_destroy( m->integrals[ j ].integral );
-
-	for( j = 0; j<m->n_dbs; j++ ) {
-		struct Databases* dbs = m->dbs[ j ];
-		if( dbs ) {
-			if( dbs->read )
-				qs_db_destroy( dbs->read );
-			if( dbs->readwrite )
-				qs_db_destroy( dbs->readwrite );
-
-			free( dbs );
+	for( j = 0; j<m->n_sectors; j++ ) {
+		struct Sector* sector = m->sectors[ j ];
+		if( sector ) {
+			arena_destroy( sector->arenas );
+
+			if( sector->dbs.read )
+				qs_db_destroy( sector->dbs.read );
+			if( sector->dbs.readwrite )
+				qs_db_destroy( sector->dbs.readwrite );
+
+			pthread_mutex_destroy( &sector->lock );
+			free( sector );
 		}
 	}
 
-	for( j = 0; j<m->n_substitutions; j++ ) {
-		free( m->substitutions[ j ].name );
-		free( m->substitutions[ j ].value );
+	for( j = 0; j<INDEX_SHARDS; j++ ) {
+		pthread_mutex_destroy( &m->index[ j ].lock );
+		free( m->index[ j ].slots );
 	}
 
-	free( m->substitutions );
-	free( m->integrals );
+	size_t k;
+	for( k = 0; k<N_PAGES; k++ )
+		free( m->pages[ k ] );
+
+	pthread_rwlock_destroy( &m->sectors_lock );
+
+	qs_substitution_destroy( m->substitutions );
+	free( m->sectors );
+	free( m->pages );
 	free( m->ro_prefix );
 	free( m->ro_suffix );
 	free( m->rw_prefix );
 	free( m->rw_suffix );
-	free( m->dbs );
 	free( m );
 }
@@ -7,9 +7,13 @@ typedef struct QsIntegralMgr* QsIntegralMgr;
 
 QsIntegralMgr qs_integral_mgr_new_with_size( const char*,const char*,const char*,const char*,unsigned );
 QsComponent qs_integral_mgr_manage( QsIntegralMgr,QsIntegral );
+QsComponent qs_integral_mgr_manage_powers( QsIntegralMgr,QsPrototype,unsigned,const QsPower* );
 QsIntegral qs_integral_mgr_peek( QsIntegralMgr,QsComponent );
 void qs_integral_mgr_destroy( QsIntegralMgr );
 QsExpression qs_integral_mgr_load_raw( QsIntegralMgr,QsIntegral,struct QsMetadata* );
 struct QsReflist qs_integral_mgr_load_expression( QsIntegralMgr,QsComponent,struct QsMetadata* );
+bool qs_integral_mgr_load_meta( QsIntegralMgr,QsComponent,struct QsMetadata* );
+QsCoefficient qs_integral_mgr_load_coefficient( QsIntegralMgr,QsComponent,QsComponent );
 void qs_integral_mgr_save_expression( QsIntegralMgr,QsComponent,struct QsReflist,struct QsMetadata );
 void qs_integral_mgr_add_substitution( QsIntegralMgr,char*,char* );
+void qs_integral_mgr_sync( QsIntegralMgr );
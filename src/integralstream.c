@@ -0,0 +1,221 @@
+#include "integralstream.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define STREAM_CHUNK ( 1<<16 )
+
+/** Stream of integrals
+ *
+ * Reads a list of integrals in string representation, one per line,
+ * from a file descriptor. Regular files are mapped into memory as a
+ * whole, anything else is read in chunks of at least STREAM_CHUNK
+ * bytes. Lines are parsed where they are in the buffer and the powers
+ * are handed to the QsIntegralMgr directly, such that no allocation
+ * is made per integral.
+ */
+struct QsIntegralStream {
+	int fd;
+	bool mapped;
+	bool validated; ///< All lines have already been checked and reported
+	bool eof;
+
+	char* buffer;
+	size_t size; ///< Number of valid bytes in buffer
+	size_t allocated;
+	size_t position; ///< Beginning of the next line in buffer
+
+	unsigned line; ///< Number of the next line
+
+	unsigned allocated_powers;
+	QsPower* powers;
+};
+
+QsIntegralStream qs_integral_stream_new( int fd ) {
+	QsIntegralStream result = malloc( sizeof (struct QsIntegralStream) );
+	result->fd = fd;
+	result->mapped = false;
+	result->validated = false;
+	result->eof = false;
+	result->position = 0;
+	result->line = 1;
+	result->allocated_powers = 0;
+	result->powers = malloc( 0 );
+
+	struct stat st;
+	if( !fstat( fd,&st )&& S_ISREG( st.st_mode )&& st.st_size>0 ) {
+		void* map = mmap( NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0 );
+
+		if( map!=MAP_FAILED ) {
+			madvise( map,st.st_size,MADV_SEQUENTIAL );
+
+			result->mapped = true;
+			result->eof = true;
+			result->buffer = map;
+			result->size = result->allocated = st.st_size;
+		}
+	}
+
+	if( !result->mapped ) {
+		result->size = 0;
+		result->allocated = STREAM_CHUNK;
+		result->buffer = malloc( result->allocated );
+	}
+
+	return result;
+}
+
+/** Obtain the next line
+ *
+ * @param This
+ * @param Position in the buffer to start from
+ * @param[out] Beginning of the line
+ * @param[out] End of the line, excluding the newline
+ * @return Position after the line or 0 if there is no further line
+ */
+static size_t next_line( QsIntegralStream s,size_t position,const char** begin,const char** end ) {
+	char* newline;
+	while( !( newline = memchr( s->buffer + position,'\n',s->size - position ) )&& !s->eof ) {
+		/* Only the unmapped stream reaches this point, in which case
+		 * position is always s->position */
+		memmove( s->buffer,s->buffer + position,s->size - position );
+		s->size -= position;
+		s->position = position = 0;
+
+		if( s->allocated - s->size<STREAM_CHUNK )
+			s->buffer = realloc( s->buffer,s->allocated *= 2 );
+
+		ssize_t got = read( s->fd,s->buffer + s->size,s->allocated - s->size );
+
+		/* Errors, including interruption by a signal, end the input */
+		if( got>0 )
+			s->size += got;
+		else
+			s->eof = true;
+	}
+
+	*begin = s->buffer + position;
+
+	if( newline ) {
+		*end = newline;
+		return newline - s->buffer + 1;
+	} else if( position<s->size ) {
+		*end = s->buffer + s->size;
+		return s->size;
+	} else
+		return 0;
+}
+
+static bool is_blank( const char* begin,const char* end ) {
+	while( begin!=end )
+		if( !strchr( " \t\r",*begin++ ) )
+			return false;
+
+	return true;
+}
+
+static bool parse_line( QsIntegralStream s,const char* begin,const char* end,QsPrototype* prototype,unsigned* n_powers ) {
+	unsigned max_powers = 1;
+
+	const char* comma = begin;
+	while( ( comma = memchr( comma,',',end - comma ) ) ) {
+		max_powers++;
+		comma++;
+	}
+
+	if( s->allocated_powers<max_powers ) {
+		s->allocated_powers = max_powers;
+		s->powers = realloc( s->powers,max_powers*sizeof (QsPower) );
+	}
+
+	return qs_integral_parse( begin,end,prototype,n_powers,s->powers );
+}
+
+static void report( unsigned line,const char* begin,const char* end ) {
+	fprintf( stderr,"Warning: Could not parse line %u '%.*s'\n",line,(int)( end - begin ),begin );
+}
+
+/** Check all integrals in advance
+ *
+ * If the whole input is available, which is the case for regular
+ * files, parses all remaining lines and reports malformed ones with
+ * their line numbers. They will then be skipped silently by
+ * qs_integral_stream_next. For other inputs nothing is done.
+ *
+ * @param This
+ * @return The number of malformed lines
+ */
+unsigned qs_integral_stream_validate( QsIntegralStream s ) {
+	unsigned result = 0;
+
+	if( s->mapped && !s->validated ) {
+		unsigned line = s->line;
+		size_t position = s->position;
+
+		const char* begin,* end;
+		while( ( position = next_line( s,position,&begin,&end ) ) ) {
+			QsPrototype prototype;
+			unsigned n_powers;
+
+			if( !is_blank( begin,end )&& !parse_line( s,begin,end,&prototype,&n_powers ) ) {
+				report( line,begin,end );
+				result++;
+			}
+
+			line++;
+		}
+
+		s->validated = true;
+	}
+
+	return result;
+}
+
+/** Manage the next integral
+ *
+ * Reads up to the next well-formed integral and passes it to the
+ * QsIntegralMgr. Blank lines are skipped, malformed lines are reported
+ * and skipped.
+ *
+ * @param This
+ * @param The QsIntegralMgr to manage the integral
+ * @param[out] The component of the integral
+ * @return Whether an integral was read before the end of the input
+ */
+bool qs_integral_stream_next( QsIntegralStream s,QsIntegralMgr m,QsComponent* result ) {
+	const char* begin,* end;
+	size_t next;
+
+	while( ( next = next_line( s,s->position,&begin,&end ) ) ) {
+		unsigned line = s->line++;
+		s->position = next;
+
+		QsPrototype prototype;
+		unsigned n_powers;
+
+		if( is_blank( begin,end ) )
+			continue;
+
+		if( parse_line( s,begin,end,&prototype,&n_powers ) ) {
+			*result = qs_integral_mgr_manage_powers( m,prototype,n_powers,s->powers );
+			return true;
+		} else if( !s->validated )
+			report( line,begin,end );
+	}
+
+	return false;
+}
+
+void qs_integral_stream_destroy( QsIntegralStream s ) {
+	if( s->mapped )
+		munmap( s->buffer,s->size );
+	else
+		free( s->buffer );
+
+	free( s->powers );
+	free( s );
+}
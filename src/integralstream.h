@@ -0,0 +1,16 @@
+#ifndef _QS_INTEGRAL_STREAM_H_
+#define _QS_INTEGRAL_STREAM_H_
+
+#include <stdbool.h>
+
+#include "component.h"
+#include "integralmgr.h"
+
+typedef struct QsIntegralStream* QsIntegralStream;
+
+QsIntegralStream qs_integral_stream_new( int );
+unsigned qs_integral_stream_validate( QsIntegralStream );
+bool qs_integral_stream_next( QsIntegralStream,QsIntegralMgr,QsComponent* );
+void qs_integral_stream_destroy( QsIntegralStream );
+
+#endif
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <pthread.h>
 #include <stdatomic.h>
 
@@ -18,6 +19,8 @@
 
 #define NO_DEPENDER NULL
 
+#define CONS_INITIAL_BUCKETS 1024
+
 #if DBG_LEVEL>0
 # include <stdio.h>
 #endif
@@ -60,6 +63,10 @@ struct QsTerminalGroup {
 	unsigned allocated;
 	unsigned n_targets;
 	QsTerminal* targets;
+	unsigned* tags; ///< Tag given by the caller for each target
+	unsigned n_slots;
+	unsigned* slots; ///< Index into targets by tag, valid only if the tag there matches
+	bool notified; ///< A wait ends regardless of the targets, see qs_terminal_group_notify
 
 	atomic_uint refcount;
 
@@ -93,10 +100,16 @@ struct ADCData {
 struct BakedExpression {
 	struct Expression expression;
 	QsAEF queue;
-	QsTerminalGroup waiter;
+
+	pthread_spinlock_t waiters_lock;
+	unsigned n_waiters;
+	QsTerminalGroup* waiters; ///< Groups waiting, several if the QsTerminal is shared
 
 	struct ADCData adc;
 	atomic_uint dc;
+
+	unsigned long hash; ///< Of the expression, for hash-consing
+	QsTerminal next_consed; ///< Next QsTerminal in the same bucket
 };
 
 /** DLL Link for QsTerminals
@@ -213,19 +226,32 @@ struct QsAEF {
 
 	bool termination_notice;
 
+/** Pending QsTerminals by their expression
+ *
+ * Baking an expression which is already pending yields the pending
+ * QsTerminal again. QsTerminals are removed before their expression is
+ * cleaned up, such that the operands compared against are alive. */
+	pthread_mutex_t consing_lock;
+	unsigned n_consed;
+	unsigned n_buckets;
+	QsTerminal* buckets;
+
 #if QS_STATUS
 	bool is_numeric;
 #endif
 };
 
 static QsCompound qs_operand_discoverer( Expression,unsigned,bool*,QsOperation* );
+
 static void* worker( void* );
 static void aef_push_independent( QsAEF,QsTerminal );
+static void terminal_group_free( QsTerminalGroup );
 static QsTerminal aef_pop_independent( QsAEF );
 static void terminal_decrease_adc( QsTerminal,unsigned,unsigned );
 static void expression_clean( Expression );
 static void discard_unref( QsTerminal,bool );
 static bool qs_terminal_queued( QsTerminal );
+static void aef_cons_remove( QsAEF,QsTerminal );
 
 QsTerminalQueue qs_terminal_queue_new( ) {
 	QsTerminalQueue result = malloc( sizeof (struct QsTerminalQueue) );
@@ -410,6 +436,68 @@ void qs_terminal_load( QsTerminal t,QsCoefficient c ) {
 	}
 }
 
+/** Whether an operand has been evaluated
+ *
+ * @param This
+ *
+ * @return Whether the operand is a terminal whose evaluation has
+ * completed, regardless of whether its result is currently held in
+ * memory
+ */
+bool qs_operand_finished( QsOperand o ) {
+	if( !o->is_terminal )
+		return false;
+
+	QsTerminal t = (QsTerminal)o;
+
+	pthread_rwlock_rdlock( &t->lock );
+	bool result = t->is_result;
+	pthread_rwlock_unlock( &t->lock );
+
+	return result;
+}
+
+/** Whether an operand is referenced by others
+ *
+ * @param This
+ *
+ * @return Whether there are references besides the caller's. Others
+ * may drop theirs concurrently, but none are added unless the caller
+ * hands out references.
+ */
+bool qs_operand_shared( QsOperand o ) {
+	return atomic_load_explicit( &o->refcount,memory_order_acquire )>1;
+}
+
+/** Hand a QsTerminal over to another manager
+ *
+ * Henceforth, the QsTerminal is loaded, saved and discarded through the
+ * given manager, e.g. to save a coefficient which so far could be
+ * reloaded from elsewhere. The manager must share the queue of the
+ * former one and its identifiers must not be larger. The QsTerminal
+ * must be acquired by the caller, such that it is not popped meanwhile.
+ *
+ * @param This
+ *
+ * @param The new manager
+ *
+ * @param The new identifier
+ */
+void qs_terminal_remanage( QsTerminal t,QsTerminalMgr m,QsTerminalMeta id ) {
+	assert( t->manager && t->id );
+	assert( m->queue==t->manager->queue );
+	assert( m->identifier_size<=t->manager->identifier_size );
+
+	pthread_spin_lock( &t->result->lock );
+
+	assert( t->result->refcount>0 );
+
+	t->manager = m;
+	memcpy( t->id,id,m->identifier_size );
+
+	pthread_spin_unlock( &t->result->lock );
+}
+
 bool qs_terminal_acquired( QsTerminal t ) {
 	pthread_spin_lock( &t->result->lock );
 	bool result = t->result->coefficient;
@@ -496,6 +584,11 @@ QsAEF qs_aef_new( size_t limit_terminals  )
 	result->workers = malloc( 0 );
 	result->termination_notice = false;
 
+	pthread_mutex_init( &result->consing_lock,NULL );
+	result->n_consed = 0;
+	result->n_buckets = CONS_INITIAL_BUCKETS;
+	result->buckets = calloc( CONS_INITIAL_BUCKETS,sizeof (QsTerminal) );
+
 #if QS_STATUS
 	result->is_numeric = is_numeric;
 #endif
@@ -517,6 +610,9 @@ void qs_aef_destroy( QsAEF a ) {
 	free( a->independent );
 	free( a->workers );
 
+	pthread_mutex_destroy( &a->consing_lock );
+	free( a->buckets );
+
 	free( a );
 }
 
@@ -786,6 +882,8 @@ static void* worker( void* udata ) {
 
 			td->coefficient = result;
 
+			aef_cons_remove( self,target );
+
 			pthread_rwlock_wrlock( &target->lock );
 
 			pthread_spin_init( &td->lock,PTHREAD_PROCESS_PRIVATE );
@@ -818,18 +916,22 @@ static void* worker( void* udata ) {
 /* After the unlock, any references from the frontend may be dropped.
  * Unless there are references held from dependers, we may no longer
  * refer to the target. */
-			bool discarded = target->discarded;
+#ifdef QS_OPERAND_ALLOW_DISCARD
+			const enum Discard discarded = target->discarded;
+#endif
 
 			pthread_rwlock_unlock( &target->lock );
 
 #ifdef QS_OPERAND_ALLOW_DISCARD
 			if( discarded )
-				discard_unref( target,target->discarded==DISCARD_ZERO );
+				discard_unref( target,discarded==DISCARD_ZERO );
 #endif
 
-			QsTerminalGroup waiter = src->waiter;
+/* No more waiters are added once the target is a result */
+			unsigned k;
+			for( k = 0; k<src->n_waiters; k++ ) {
+				QsTerminalGroup waiter = src->waiters[ k ];
 
-			if( waiter ) {
 /* Lock the mutex and abuse the refcount. Since the refcount is abused
  * to indicate whether a coefficient has finished, we decrease the
  * refcount before sending the signal, which in turn happens before we
@@ -848,10 +950,8 @@ static void* worker( void* udata ) {
 
 				pthread_mutex_unlock( &waiter->lock );
 
-				if( !refcount ) {
-					free( waiter->targets );
-					free( waiter );
-				}
+				if( !refcount )
+					terminal_group_free( waiter );
 			}
 
 #if QS_STATUS
@@ -872,6 +972,7 @@ static void* worker( void* udata ) {
 
 			expression_clean( &src->expression );
 			free( src->adc.contributions );
+			free( src->waiters );
 			free( src );
 
 #if QS_STATUS
@@ -1014,7 +1115,145 @@ static void update_dvalue( QsTerminal target,ADC adc ) {
 	pthread_spin_unlock( &target->dvalue.lock );
 }
 
+static unsigned long hash_operands( unsigned n_operands,QsOperand* os,QsOperation op ) {
+	unsigned long result = ( op + 1 )*0x9e3779b97f4a7c15UL ^ n_operands;
+
+	int k;
+	for( k = 0; k<n_operands; k++ ) {
+		unsigned long h;
+		if( os[ k ]->is_terminal )
+			h =( (uintptr_t)os[ k ]>>4 )*0xff51afd7ed558ccdUL;
+		else {
+			Expression e = &( (QsIntermediate)os[ k ] )->expression;
+			h = hash_operands( e->n_operands,e->operands,e->operation );
+		}
+
+		result =( result^h )*0x100000001b3UL;
+		result ^= result>>29;
+	}
+
+	return result;
+}
+
+/** Structural equality
+ *
+ * QsTerminals are equal by identity, QsIntermediates by their
+ * expressions. */
+static bool operands_equal( unsigned n_operands,QsOperand* as,QsOperand* bs ) {
+	int k;
+	for( k = 0; k<n_operands; k++ ) {
+		QsOperand a = as[ k ];
+		QsOperand b = bs[ k ];
+
+		if( a==b )
+			continue;
+
+		if( a->is_terminal || b->is_terminal )
+			return false;
+
+		Expression ea = &( (QsIntermediate)a )->expression;
+		Expression eb = &( (QsIntermediate)b )->expression;
+		if( ea->operation!=eb->operation || ea->n_operands!=eb->n_operands || !operands_equal( ea->n_operands,ea->operands,eb->operands ) )
+			return false;
+	}
+
+	return true;
+}
+
+/** Find a pending QsTerminal by its expression
+ *
+ * Only pending QsTerminals are found. Once evaluated, a QsTerminal drops
+ * its operands, whose addresses may then be reused, so its expression
+ * no longer identifies it. QsIntermediates are not consed either, each
+ * is consumed by exactly one expression.
+ *
+ * Must be called with the consing_lock held.
+ */
+static QsTerminal aef_cons_find( QsAEF a,unsigned long hash,unsigned n_operands,QsOperand* os,QsOperation op,QsTerminalMgr m ) {
+	QsTerminal t;
+	for( t = a->buckets[ hash&( a->n_buckets - 1 ) ]; t; t = t->expression->next_consed ) {
+		Expression e = &t->expression->expression;
+
+		if( t->expression->hash==hash && t->manager==m && e->operation==op && e->n_operands==n_operands && operands_equal( n_operands,e->operands,os ) )
+			return t;
+	}
+
+	return NULL;
+}
+
+static void aef_cons_insert( QsAEF a,QsTerminal t ) {
+	pthread_mutex_lock( &a->consing_lock );
+
+	if( a->n_consed==a->n_buckets ) {
+		QsTerminal* buckets = calloc( 2*a->n_buckets,sizeof (QsTerminal) );
+
+		int j;
+		for( j = 0; j<a->n_buckets; j++ )
+			while( a->buckets[ j ] ) {
+				QsTerminal next = a->buckets[ j ];
+				a->buckets[ j ]= next->expression->next_consed;
+
+				QsTerminal* bucket = buckets + ( next->expression->hash&( 2*a->n_buckets - 1 ) );
+				next->expression->next_consed = *bucket;
+				*bucket = next;
+			}
+
+		free( a->buckets );
+		a->buckets = buckets;
+		a->n_buckets *= 2;
+	}
+
+	QsTerminal* bucket = a->buckets + ( t->expression->hash&( a->n_buckets - 1 ) );
+	t->expression->next_consed = *bucket;
+	*bucket = t;
+	a->n_consed++;
+
+	pthread_mutex_unlock( &a->consing_lock );
+}
+
+static void aef_cons_remove( QsAEF a,QsTerminal t ) {
+	pthread_mutex_lock( &a->consing_lock );
+
+	QsTerminal* link = a->buckets + ( t->expression->hash&( a->n_buckets - 1 ) );
+	while( *link!=t )
+		link = &( *link )->expression->next_consed;
+
+	*link = t->expression->next_consed;
+	a->n_consed--;
+
+	pthread_mutex_unlock( &a->consing_lock );
+}
+
+/** Bake an expression into a QsTerminal
+ *
+ * If the same operation on the same operands is pending already, that
+ * QsTerminal is referenced instead, the operands are not and id is
+ * discarded as by qs_operand_terminate.
+ */
 QsTerminal qs_operand_bake( unsigned n_operands,QsOperand* os,QsOperation op,QsAEF queue,QsTerminalMgr m,QsTerminalMeta id ) {
+	const unsigned long hash = hash_operands( n_operands,os,op );
+
+	pthread_mutex_lock( &queue->consing_lock );
+	QsTerminal consed = aef_cons_find( queue,hash,n_operands,os,op,m );
+	if( consed )
+		qs_operand_ref( (QsOperand)consed );
+	pthread_mutex_unlock( &queue->consing_lock );
+
+	if( consed ) {
+		DBG_PRINT_3( "Baking found pending %p\n",0,consed );
+
+		int k;
+		for( k = 0; k<n_operands; k++ )
+			if( !os[ k ]->is_terminal ) {
+				assert( !( (QsIntermediate)os[ k ] )->debug_used );
+				( (QsIntermediate)os[ k ] )->debug_used = true;
+			}
+
+		if( m && m->discarder && id )
+			m->discarder( id,m->upointer );
+
+		return consed;
+	}
 
 	QsTerminal result = malloc( sizeof (struct QsTerminal) +( id?m->identifier_size:0 ) );
 	aef_count_terminal( queue,result );
@@ -1059,7 +1298,10 @@ QsTerminal qs_operand_bake( unsigned n_operands,QsOperand* os,QsOperation op,QsA
 	atomic_thread_fence( memory_order_acq_rel );
 
 	b->queue = queue;
-	b->waiter = NULL;
+	pthread_spin_init( &b->waiters_lock,PTHREAD_PROCESS_PRIVATE );
+	b->n_waiters = 0;
+	b->waiters = NULL;
+	b->hash = hash;
 
 	e->operation = op;
 	e->n_operands = n_operands;
@@ -1110,6 +1352,8 @@ QsTerminal qs_operand_bake( unsigned n_operands,QsOperand* os,QsOperation op,QsA
 
 	pthread_rwlock_unlock( &result->lock );
 
+	aef_cons_insert( queue,result );
+
 	pthread_spin_lock( &b->adc.adc_contribution_lock );
 	terminal_decrease_adc( result,0,0 );
 	terminal_independ( result );
@@ -1193,10 +1437,18 @@ static void expression_clean( Expression e ) {
 
 #ifdef QS_OPERAND_ALLOW_DISCARD
 void qs_operand_discard( QsTerminal t,bool zero ) {
-	pthread_rwlock_rdlock( &t->lock );
+	pthread_rwlock_wrlock( &t->lock );
 	if( t->is_result ) {
 		pthread_rwlock_unlock( &t->lock );
 		discard_unref( t,zero );
+	} else if( t->discarded ) {
+		/* Shared by baking the same expression, the reference of the first
+		 * discard is kept until evaluated and checked for zero if any of
+		 * the discards requires it */
+		if( zero )
+			t->discarded = DISCARD_ZERO;
+		pthread_rwlock_unlock( &t->lock );
+		qs_operand_unref( (QsOperand)t );
 	} else {
 		t->discarded = zero?DISCARD_ZERO:DISCARD_ANY;
 		pthread_rwlock_unlock( &t->lock );
@@ -1472,6 +1724,13 @@ static QsTerminal aef_pop_independent( QsAEF a ) {
 	return result;
 }
 
+static void terminal_group_free( QsTerminalGroup g ) {
+	free( g->targets );
+	free( g->tags );
+	free( g->slots );
+	free( g );
+}
+
 QsTerminalGroup qs_terminal_group_new( unsigned size ) {
 	QsTerminalGroup result = malloc( sizeof (struct QsTerminalGroup) );
 	pthread_mutex_init( &result->lock,NULL );
@@ -1479,17 +1738,58 @@ QsTerminalGroup qs_terminal_group_new( unsigned size ) {
 	result->allocated = size;
 	result->n_targets = 0;
 	result->targets = malloc( size*sizeof (QsTerminal) );
+	result->tags = malloc( size*sizeof (unsigned) );
+	result->n_slots = 0;
+	result->slots = NULL;
+	result->notified = false;
 	atomic_init( &result->refcount,1 );
 	atomic_thread_fence( memory_order_acq_rel );
 
 	return result;
 }
 
+/** Record the index of the target with a tag
+ *
+ * @param This
+ * @param Tag
+ * @param Index into the targets
+ */
+static void set_slot( QsTerminalGroup g,unsigned tag,unsigned j ) {
+	if( tag>=g->n_slots ) {
+		unsigned n_slots = g->n_slots ? g->n_slots : 1;
+		while( tag>=n_slots )
+			n_slots *= 2;
+
+		g->slots = realloc( g->slots,n_slots*sizeof (unsigned) );
+		g->n_slots = n_slots;
+	}
+
+	g->slots[ tag ]= j;
+}
+
 unsigned qs_terminal_group_push( QsTerminalGroup g,QsTerminal t ) {
-	if( g->allocated==g->n_targets )
+	return qs_terminal_group_push_tagged( g,t,0 );
+}
+
+/** Push terminal along with a tag
+ *
+ * The tag is handed back when the terminal is popped, such that the
+ * caller need not look up what the terminal belongs to.
+ *
+ * @param This
+ * @param The terminal
+ * @param Tag of the caller's choice
+ * @return Number of targets before the push
+ */
+unsigned qs_terminal_group_push_tagged( QsTerminalGroup g,QsTerminal t,unsigned tag ) {
+	if( g->allocated==g->n_targets ) {
 		g->targets = realloc( g->targets,++( g->allocated )*sizeof (QsTerminal) );
+		g->tags = realloc( g->tags,g->allocated*sizeof (unsigned) );
+	}
 
 	g->targets[ g->n_targets ]= t;
+	g->tags[ g->n_targets ]= tag;
+	set_slot( g,tag,g->n_targets );
 	g->n_targets++;
 
 	pthread_rwlock_rdlock( &t->lock );
@@ -1498,8 +1798,10 @@ unsigned qs_terminal_group_push( QsTerminalGroup g,QsTerminal t ) {
 
 		atomic_fetch_add_explicit( &g->refcount,1,memory_order_release );
 
-		assert( !e->waiter );
-		e->waiter = g;
+		pthread_spin_lock( &e->waiters_lock );
+		e->waiters = realloc( e->waiters,( e->n_waiters + 1 )*sizeof (QsTerminalGroup) );
+		e->waiters[ e->n_waiters++ ]= g;
+		pthread_spin_unlock( &e->waiters_lock );
 	}
 	pthread_rwlock_unlock( &t->lock );
 
@@ -1510,13 +1812,41 @@ void qs_terminal_group_wait( QsTerminalGroup g ) {
 	pthread_mutex_lock( &g->lock );
 
 	if( g->n_targets )
-		while( atomic_load_explicit( &g->refcount,memory_order_acquire )==g->n_targets + 1 )
+		while( !g->notified && atomic_load_explicit( &g->refcount,memory_order_acquire )==g->n_targets + 1 )
 			pthread_cond_wait( &g->change,&g->lock );
 
+	g->notified = false;
+
+	pthread_mutex_unlock( &g->lock );
+}
+
+/** End a wait on the group
+ *
+ * May be called from any thread, e.g. when the waiter has further
+ * targets to consider. If nobody waits, the next wait returns right away.
+ *
+ * @param This
+ */
+void qs_terminal_group_notify( QsTerminalGroup g ) {
+	pthread_mutex_lock( &g->lock );
+
+	g->notified = true;
+	pthread_cond_signal( &g->change );
+
 	pthread_mutex_unlock( &g->lock );
 }
 
 QsTerminal qs_terminal_group_pop( QsTerminalGroup g ) {
+	return qs_terminal_group_pop_tagged( g,NULL );
+}
+
+/** Pop finished terminal along with its tag
+ *
+ * @param This
+ * @param[out] Tag the terminal was pushed with, if not NULL
+ * @return A finished terminal or NULL if none is finished
+ */
+QsTerminal qs_terminal_group_pop_tagged( QsTerminalGroup g,unsigned* tag ) {
 	QsTerminal result = NULL;
 	if( atomic_load_explicit( &g->refcount,memory_order_acquire )!=g->n_targets + 1 ) {
 		int j = 0;
@@ -1528,9 +1858,14 @@ QsTerminal qs_terminal_group_pop( QsTerminalGroup g ) {
 				pthread_rwlock_unlock( &target->lock );
 
 				result = target;
+				if( tag )
+					*tag = g->tags[ j ];
 
-				g->targets[ j ]= g->targets[ g->n_targets - 1 ];
 				g->n_targets--;
+				g->targets[ j ]= g->targets[ g->n_targets ];
+				g->tags[ j ]= g->tags[ g->n_targets ];
+				if( j<g->n_targets && g->slots[ g->tags[ j ] ]==g->n_targets )
+					g->slots[ g->tags[ j ] ]= j;
 			} else
 				pthread_rwlock_unlock( &target->lock );
 
@@ -1550,10 +1885,8 @@ void qs_terminal_group_destroy( QsTerminalGroup g ) {
 	unsigned new = atomic_fetch_sub_explicit( &g->refcount,1,memory_order_acq_rel )- 1;
 	pthread_mutex_unlock( &g->lock );
 
-	if( !new ) {
-		free( g->targets );
-		free( g );
-	}
+	if( !new )
+		terminal_group_free( g );
 }
 
 void qs_terminal_group_clear( QsTerminalGroup g ) {
@@ -1570,9 +1903,16 @@ void qs_terminal_group_clear( QsTerminalGroup g ) {
 			pthread_rwlock_rdlock( &target->lock );
 
 			if( !target->is_result ) {
-				assert( target->expression->waiter );
+				BakedExpression e = target->expression;
+
+				pthread_spin_lock( &e->waiters_lock );
+				int k = 0;
+				while( e->waiters[ k ]!=g )
+					k++;
+				e->waiters[ k ]= e->waiters[ --e->n_waiters ];
+				pthread_spin_unlock( &e->waiters_lock );
+
 				atomic_fetch_sub_explicit( &g->refcount,1,memory_order_relaxed );
-				target->expression->waiter = NULL;
 			}
 
 			pthread_rwlock_unlock( &target->lock );
@@ -1591,6 +1931,27 @@ QsTerminal qs_terminal_wait( QsTerminal t ) {
 	return t;
 }
 
+/** Change tag of a pending terminal
+ *
+ * The terminal is found by its tag in constant time, for which tags
+ * of pending terminals must be distinct. Nothing happens if no pending
+ * terminal carries the tag.
+ *
+ * @param This
+ * @param Tag to be replaced
+ * @param New tag
+ */
+void qs_terminal_group_retag( QsTerminalGroup g,unsigned from,unsigned to ) {
+	if( from>=g->n_slots )
+		return;
+
+	const unsigned j = g->slots[ from ];
+	if( j<g->n_targets && g->tags[ j ]==from ) {
+		g->tags[ j ]= to;
+		set_slot( g,to,j );
+	}
+}
+
 unsigned qs_terminal_group_count( QsTerminalGroup g ) {
 	return g->n_targets;
 }
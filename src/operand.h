@@ -105,12 +105,18 @@ QsTerminal qs_operand_new( QsTerminalMgr,QsTerminalMeta );
 QsTerminal qs_operand_bake( unsigned,QsOperand*,QsOperation,QsAEF,QsTerminalMgr,QsTerminalMeta );
 QsTerminal qs_operand_terminate( QsOperand,QsAEF,QsTerminalMgr,QsTerminalMeta );
 QsIntermediate qs_operand_link( unsigned,QsOperand*,QsOperation );
+bool qs_operand_finished( QsOperand );
+bool qs_operand_shared( QsOperand );
 
 QsTerminalGroup qs_terminal_group_new( unsigned );
 QsTerminal qs_terminal_wait( QsTerminal );
 unsigned qs_terminal_group_push( QsTerminalGroup,QsTerminal );
+unsigned qs_terminal_group_push_tagged( QsTerminalGroup,QsTerminal,unsigned );
 void qs_terminal_group_wait( QsTerminalGroup );
+void qs_terminal_group_notify( QsTerminalGroup );
 QsTerminal qs_terminal_group_pop( QsTerminalGroup );
+QsTerminal qs_terminal_group_pop_tagged( QsTerminalGroup,unsigned* );
+void qs_terminal_group_retag( QsTerminalGroup,unsigned,unsigned );
 unsigned qs_terminal_group_count( QsTerminalGroup );
 void qs_terminal_group_clear( QsTerminalGroup );
 void qs_terminal_group_destroy( QsTerminalGroup );
@@ -123,6 +129,7 @@ QsTerminalMgr qs_terminal_mgr_new( QsTerminalLoader,QsTerminalSaver,QsTerminalDi
 void qs_terminal_mgr_destroy( QsTerminalMgr );
 
 bool qs_terminal_acquired( QsTerminal );
+void qs_terminal_remanage( QsTerminal,QsTerminalMgr,QsTerminalMeta );
 void qs_terminal_load( QsTerminal,QsCoefficient );
 QsCoefficient qs_terminal_acquire( QsTerminal );
 void qs_terminal_release( QsTerminal );
@@ -8,8 +8,18 @@
 #include <assert.h>
 #include <pthread.h>
 #include <stdatomic.h>
+#include <limits.h>
 
 #define COLLECT_PREALLOC 4
+#define COMPONENT_PAGE_BITS 12
+#define COMPONENT_PAGE_SIZE ( 1<<COMPONENT_PAGE_BITS )
+#define EVICT_SCAN 16
+#define SLAB_SIZE ( 1<<20 )
+#define SLAB_LARGE 16 ///< Blocks above SLAB_SIZE/SLAB_LARGE bytes are not carved from slabs
+#define REFS_MIN_CLASS 2
+#define REFS_CLASSES ( CHAR_BIT*sizeof (unsigned) )
+#define GROUP_EMPTY ( (unsigned)-1 )
+#define GROUP_HASH( c,bits ) ( (unsigned)( (c)*2654435769u )>>( CHAR_BIT*sizeof (unsigned) - (bits) ) )
 #define COEFFICIENT_UID_MAX_LOW ( ( (CoefficientUID)(-1) )>>1 )
 #define COEFFICIENT_UID_MAX_HIGH ( ( (CoefficientUID)(-1) ) )
 #define COEFFICIENT_META_NEW( g ) ( &(struct CoefficientMeta){ generate_id( g ),false } )
@@ -30,25 +40,91 @@ struct CoefficientId {
 	QsComponent head;
 };
 
+/** Identifier of an initial coefficient
+ *
+ * Leaves room for a CoefficientMeta, which replaces the CoefficientId
+ * once the coefficient is handed over to the backing storage. */
+union InitialId {
+	struct CoefficientId id;
+	struct CoefficientMeta meta;
+};
+
 struct Reference {
 	QsComponent head;
 	QsOperand coefficient;
 	QsOperand numeric;
 };
 
-typedef struct {
+enum PrefetchState {
+	PREFETCH_NONE = 0,
+	PREFETCH_QUEUED,
+	PREFETCH_LOADING,
+	PREFETCH_DONE,
+	PREFETCH_TAKEN ///< Loaded by or handed to the frontend, never prefetched again
+};
+
+struct PrefetchSlot {
+	unsigned char state;
+	unsigned char depth; ///< Remaining depth when queued
+
+	struct QsReflist list;
+	struct QsMetadata meta;
+};
+
+typedef struct Pivot {
+	QsComponent component;
+
+	struct Pivot* lru_prev; ///< More recently used pivot
+	struct Pivot* lru_next; ///< Less recently used pivot
+
 	unsigned n_refs;
+	unsigned char refs_class; ///< Capacity of refs is 1<<refs_class
+	bool sorted; ///< Whether refs is known to be ordered by head
 	struct Reference* refs;
 
+	unsigned owner; ///< Frontend eliminating in the pivot or 0
+
+	unsigned n_initial;
+	QsTerminal* initial; ///< Initial coefficients which may be reloaded from the identity, only kept with a memory limit
+
 	struct QsMetadata meta;
 } Pivot;
 
 struct QsPivotGraph {
-	unsigned n_components;
-	unsigned allocated;
-	Pivot** components;
+	/** Pivots by component
+	 *
+	 * Two level table of pages of COMPONENT_PAGE_SIZE pivots, which are
+	 * allocated when a component of theirs is first loaded. Only the
+	 * directory of pages grows. */
+	unsigned n_components; ///< Bound on the components which have been loaded
+	unsigned n_pages;
+	Pivot*** pages;
+
+	/** Loaded pivots in order of use
+	 *
+	 * If there are more than limit pivots, the least recently used ones
+	 * are saved and unloaded. */
+	struct {
+		unsigned limit; ///< 0 for no limit
+		unsigned n_pivots;
+		Pivot* first;
+		Pivot* last;
+	} lru;
+
+	/** Concurrent frontends
+	 *
+	 * Frontends hold lock while they operate on the graph and release it
+	 * only while they wait for evaluations. A pivot is eliminated in by
+	 * one frontend at a time, its owner. Owners change under lock and
+	 * are announced through change. */
+	struct {
+		pthread_mutex_t lock;
+		pthread_cond_t change;
+	} frontend;
 
 	QsLoadFunction loader;
+	QsMetaFunction meta_loader;
+	QsFetchFunction fetcher;
 	QsSaveFunction saver;
 	void* load_data;
 	void* save_data;
@@ -66,18 +142,130 @@ struct QsPivotGraph {
 		QsTerminalMgr mgr;
 
 		pthread_mutex_t lock;
-		pthread_mutex_t initial_lock;
 		pthread_mutex_t terminal_lock;
 		pthread_mutex_t initial_terminal_lock;
 		QsDb storage;
 	} memory;
 
+	/** Lookahead loading of identities
+	 *
+	 * A background thread loads the identities of the heads of pivots
+	 * which are about to be considered, so that qs_pivot_graph_meta
+	 * finds them ready. Everything but the thread itself is guarded by
+	 * lock. */
+	struct {
+		bool running;
+		bool terminate;
+		pthread_t thread;
+
+		unsigned depth;
+		size_t limit;
+		size_t usage; ///< Coefficient bytes held in PREFETCH_DONE slots
+
+		pthread_mutex_t lock;
+		pthread_cond_t change;
+
+		unsigned n_pages;
+		struct PrefetchSlot** pages; ///< Slots by component, paged as the pivots
+
+		unsigned queue_begin;
+		unsigned queue_end;
+		unsigned queue_allocated;
+		QsComponent* queue;
+	} prefetch;
+
+	/** Storage of pivots
+	 *
+	 * Pivots and their reference lists are carved from slabs and
+	 * recycled through free lists, the reference lists by size classes of
+	 * powers of two. A list which grows moves up one or more classes, so
+	 * that relaying into a pivot does not reallocate on every edit. */
+	struct {
+		unsigned n_slabs;
+		char** slabs;
+		size_t slab_used; ///< Bytes used in the last slab
+
+		void* free_pivots;
+		void* free_refs[ REFS_CLASSES ];
+	} storage;
+
+	/** Scratch space of qs_pivot_graph_collect_all
+	 *
+	 * Retained between calls, since collection follows every relay. */
+	struct {
+		unsigned table_bits;
+		unsigned* table; ///< Open addressing from heads to groups
+
+		unsigned allocated;
+		unsigned* group_of; ///< Group by reference
+		unsigned* group_size;
+		unsigned* group_first; ///< First reference of a group
+		QsOperand* operands;
+		QsOperand* operands_numeric;
+	} grouping;
+
 	QsAEF aef;
 	QsAEF aef_numeric;
 
 	QsOperand one;
 };
 
+/** Obtain the page of a component in a paged table
+ *
+ * Grows the directory and allocates the page, zeroed, if they do not
+ * cover the component yet. Pages never move once allocated.
+ *
+ * @param[in,out] Directory of pages
+ * @param[in,out] Number of pages in the directory
+ * @param Component
+ * @param Size of an entry
+ * @return The page
+ */
+static void* component_page( void*** pages,unsigned* n_pages,QsComponent i,size_t size ) {
+	const unsigned page = i>>COMPONENT_PAGE_BITS;
+
+	if( !( page<*n_pages ) ) {
+		unsigned n = *n_pages?2**n_pages:1;
+		while( !( page<n ) )
+			n *= 2;
+
+		*pages = realloc( *pages,n*sizeof (void*) );
+		memset( *pages + *n_pages,0,( n - *n_pages )*sizeof (void*) );
+		*n_pages = n;
+	}
+
+	if( !( *pages )[ page ] )
+		( *pages )[ page ]= calloc( COMPONENT_PAGE_SIZE,size );
+
+	return ( *pages )[ page ];
+}
+
+/** Obtain the table entry of a component
+ *
+ * Allocates the page of the component if it does not exist yet.
+ */
+static Pivot** pivot_slot( QsPivotGraph g,QsComponent i ) {
+	Pivot** page = component_page( (void***)&g->pages,&g->n_pages,i,sizeof (Pivot*) );
+
+	if( !( i<g->n_components ) )
+		g->n_components = i + 1;
+
+	return page +( i&( COMPONENT_PAGE_SIZE - 1 ) );
+}
+
+/** Look up a loaded pivot
+ *
+ * @return The pivot or NULL if it is not loaded
+ */
+static Pivot* pivot_of( QsPivotGraph g,QsComponent i ) {
+	const unsigned page = i>>COMPONENT_PAGE_BITS;
+
+	if( !( page<g->n_pages && g->pages[ page ] ) )
+		return NULL;
+
+	return g->pages[ page ][ i&( COMPONENT_PAGE_SIZE - 1 ) ];
+}
+
 static CoefficientUID generate_id( QsPivotGraph g ) {
 	if( g->memory.current_id==COEFFICIENT_UID_MAX_HIGH ) {
 		assert( atomic_load( &g->memory.n_low_ids )==0 );
@@ -126,14 +314,41 @@ static void memory_change( size_t bytes,bool less,QsPivotGraph g ) {
 }
 
 static void initial_terminal_loader( QsTerminal t,struct CoefficientId* id,QsPivotGraph g ) {
+	if( g->fetcher ) {
+		pthread_mutex_lock( &g->memory.initial_terminal_lock );
+		bool acquired = qs_terminal_acquired( t );
+		const struct CoefficientId fetched = *id;
+		pthread_mutex_unlock( &g->memory.initial_terminal_lock );
+
+		if( acquired )
+			return;
+
+		/* Fetch without holding the lock, at the expense of fetching twice
+		 * when the same terminal is reloaded concurrently. If the terminal
+		 * is spilled meanwhile, the identity may be rewritten before the
+		 * fetch, but the spill loads the terminal, which our acquisition
+		 * keeps loaded */
+		QsCoefficient coefficient = g->fetcher( g->load_data,fetched.tail,fetched.head );
+
+		pthread_mutex_lock( &g->memory.initial_terminal_lock );
+
+		if( !qs_terminal_acquired( t ) ) {
+			assert( coefficient );
+			qs_terminal_load( t,coefficient );
+		} else if( coefficient )
+			qs_coefficient_destroy( coefficient );
+
+		pthread_mutex_unlock( &g->memory.initial_terminal_lock );
+
+		return;
+	}
+
 	pthread_mutex_lock( &g->memory.initial_terminal_lock );
 
 	if( !qs_terminal_acquired( t ) ) { 
 		struct QsMetadata meta;
 
-		pthread_mutex_lock( &g->memory.initial_lock );
 		struct QsReflist l = g->loader( g->load_data,id->tail,&meta );
-		pthread_mutex_unlock( &g->memory.initial_lock );
 
 		assert( l.n_references );
 
@@ -195,12 +410,374 @@ static void terminal_discarder( struct CoefficientMeta* id,QsPivotGraph g ) {
 	drop_id( g,id->uid );
 }
 
-QsPivotGraph qs_pivot_graph_new_with_size( QsAEF aef,QsAEF aef_numeric,void* load_data,QsLoadFunction loader,void* save_data,QsSaveFunction saver,QsDb cstorage,size_t memory_max,unsigned prealloc ) {
+static void* slab_carve( QsPivotGraph g,size_t size ) {
+	size =( size + sizeof (void*)- 1 )&~( sizeof (void*)- 1 );
+
+	if( !g->storage.n_slabs || g->storage.slab_used + size>SLAB_SIZE ) {
+		g->storage.slabs = realloc( g->storage.slabs,( g->storage.n_slabs + 1 )*sizeof (char*) );
+		g->storage.slabs[ g->storage.n_slabs++ ]= malloc( SLAB_SIZE );
+		g->storage.slab_used = 0;
+	}
+
+	void* result = g->storage.slabs[ g->storage.n_slabs - 1 ]+ g->storage.slab_used;
+	g->storage.slab_used += size;
+
+	return result;
+}
+
+static size_t refs_bytes( unsigned char class ) {
+	return ( (size_t)1<<class )*sizeof (struct Reference);
+}
+
+static struct Reference* refs_alloc( QsPivotGraph g,unsigned char class ) {
+	if( refs_bytes( class )>SLAB_SIZE/SLAB_LARGE )
+		return malloc( refs_bytes( class ) );
+
+	void* result = g->storage.free_refs[ class ];
+
+	if( result )
+		g->storage.free_refs[ class ]= *(void**)result;
+	else
+		result = slab_carve( g,refs_bytes( class ) );
+
+	return result;
+}
+
+static void refs_free( QsPivotGraph g,struct Reference* refs,unsigned char class ) {
+	if( refs_bytes( class )>SLAB_SIZE/SLAB_LARGE )
+		free( refs );
+	else {
+		*(void**)refs = g->storage.free_refs[ class ];
+		g->storage.free_refs[ class ]= refs;
+	}
+}
+
+static unsigned char refs_class( unsigned n ) {
+	unsigned char result = REFS_MIN_CLASS;
+	while( ( (size_t)1<<result )<n )
+		result++;
+
+	return result;
+}
+
+static void refs_move( QsPivotGraph g,Pivot* p,unsigned char class ) {
+	struct Reference* refs = refs_alloc( g,class );
+	memcpy( refs,p->refs,p->n_refs*sizeof (struct Reference) );
+	refs_free( g,p->refs,p->refs_class );
+
+	p->refs = refs;
+	p->refs_class = class;
+}
+
+/** Ensure capacity of a reference list
+ *
+ * Grows the reference list of a pivot to hold at least the given
+ * number of references. The current references are retained.
+ */
+static void refs_reserve( QsPivotGraph g,Pivot* p,unsigned n ) {
+	if( ( (size_t)1<<p->refs_class )<n )
+		refs_move( g,p,refs_class( n ) );
+}
+
+/** Release excess capacity of a reference list
+ *
+ * Moves the reference list of a pivot to a smaller class once it is
+ * used to less than a quarter, such that shrinking and growing around a
+ * class boundary does not move the list every time.
+ */
+static void refs_trim( QsPivotGraph g,Pivot* p ) {
+	if( p->refs_class>REFS_MIN_CLASS && 4*(size_t)p->n_refs<=( (size_t)1<<p->refs_class ) )
+		refs_move( g,p,refs_class( 2*p->n_refs ) );
+}
+
+static void lru_unlink( QsPivotGraph g,Pivot* p ) {
+	if( p->lru_prev )
+		p->lru_prev->lru_next = p->lru_next;
+	else
+		g->lru.first = p->lru_next;
+
+	if( p->lru_next )
+		p->lru_next->lru_prev = p->lru_prev;
+	else
+		g->lru.last = p->lru_prev;
+
+	g->lru.n_pivots--;
+}
+
+static void lru_push( QsPivotGraph g,Pivot* p ) {
+	p->lru_prev = NULL;
+	p->lru_next = g->lru.first;
+
+	if( g->lru.first )
+		g->lru.first->lru_prev = p;
+	else
+		g->lru.last = p;
+
+	g->lru.first = p;
+	g->lru.n_pivots++;
+}
+
+static Pivot* pivot_new( QsPivotGraph g,unsigned n_refs ) {
+	Pivot* result = g->storage.free_pivots;
+
+	if( result )
+		g->storage.free_pivots = *(void**)result;
+	else
+		result = slab_carve( g,sizeof (Pivot) );
+
+	result->n_refs = n_refs;
+	result->sorted = false;
+	result->refs_class = refs_class( n_refs );
+	result->refs = refs_alloc( g,result->refs_class );
+
+	return result;
+}
+
+static size_t reflist_size( struct QsReflist l ) {
+	size_t result = 0;
+
+	int j;
+	for( j = 0; j<l.n_references; j++ )
+		result += qs_coefficient_size( l.references[ j ].coefficient );
+
+	return result;
+}
+
+static void reflist_destroy( struct QsReflist l ) {
+	int j;
+	for( j = 0; j<l.n_references; j++ )
+		qs_coefficient_destroy( l.references[ j ].coefficient );
+
+	free( l.references );
+}
+
+/** Obtain the prefetch slot of a component
+ *
+ * The prefetch lock must be held.
+ */
+static struct PrefetchSlot* prefetch_slot( QsPivotGraph g,QsComponent i ) {
+	struct PrefetchSlot* page = component_page( (void***)&g->prefetch.pages,&g->prefetch.n_pages,i,sizeof (struct PrefetchSlot) );
+
+	return page +( i&( COMPONENT_PAGE_SIZE - 1 ) );
+}
+
+/** Queue a component for prefetching
+ *
+ * The prefetch lock must be held. Components which have already been
+ * queued or loaded are ignored.
+ */
+static void prefetch_enqueue( QsPivotGraph g,QsComponent i,unsigned depth ) {
+	struct PrefetchSlot* slot = prefetch_slot( g,i );
+
+	if( slot->state!=PREFETCH_NONE )
+		return;
+
+	if( g->prefetch.queue_end==g->prefetch.queue_allocated ) {
+		unsigned n_queued = g->prefetch.queue_end - g->prefetch.queue_begin;
+
+		if( g->prefetch.queue_begin )
+			memmove( g->prefetch.queue,g->prefetch.queue + g->prefetch.queue_begin,n_queued*sizeof (QsComponent) );
+		g->prefetch.queue_begin = 0;
+		g->prefetch.queue_end = n_queued;
+
+		/* Grow if compaction left less than half the queue free, or
+		 * nothing at all, as before the first component is queued */
+		if( g->prefetch.queue_end==g->prefetch.queue_allocated || 2*n_queued>g->prefetch.queue_allocated ) {
+			g->prefetch.queue_allocated = g->prefetch.queue_allocated?2*g->prefetch.queue_allocated:COLLECT_PREALLOC;
+			g->prefetch.queue = realloc( g->prefetch.queue,g->prefetch.queue_allocated*sizeof (QsComponent) );
+		}
+	}
+
+	slot->state = PREFETCH_QUEUED;
+	slot->depth = depth;
+	g->prefetch.queue[ g->prefetch.queue_end++ ]= i;
+
+	pthread_cond_broadcast( &g->prefetch.change );
+}
+
+static void* prefetcher( QsPivotGraph g ) {
+	pthread_mutex_lock( &g->prefetch.lock );
+
+	while( !g->prefetch.terminate ) {
+		if( g->prefetch.queue_begin==g->prefetch.queue_end ) {
+			pthread_cond_wait( &g->prefetch.change,&g->prefetch.lock );
+			continue;
+		}
+
+		QsComponent i = g->prefetch.queue[ g->prefetch.queue_begin++ ];
+		struct PrefetchSlot* slot = prefetch_slot( g,i );
+
+		if( slot->state!=PREFETCH_QUEUED )
+			continue;
+
+		/* Over budget, forget the request such that it may be repeated */
+		if( g->prefetch.limit && g->prefetch.usage>g->prefetch.limit ) {
+			slot->state = PREFETCH_NONE;
+			continue;
+		}
+
+		slot->state = PREFETCH_LOADING;
+		unsigned depth = slot->depth;
+
+		pthread_mutex_unlock( &g->prefetch.lock );
+
+		struct QsMetadata meta;
+		struct QsReflist l = g->loader( g->load_data,i,&meta );
+		size_t size = reflist_size( l );
+
+		pthread_mutex_lock( &g->prefetch.lock );
+
+		slot->state = PREFETCH_DONE;
+		slot->list = l;
+		slot->meta = meta;
+		g->prefetch.usage += size;
+
+		if( depth>1 ) {
+			int j;
+			for( j = 0; j<l.n_references; j++ )
+				prefetch_enqueue( g,l.references[ j ].head,depth - 1 );
+		}
+
+		pthread_cond_broadcast( &g->prefetch.change );
+	}
+
+	pthread_mutex_unlock( &g->prefetch.lock );
+
+	return NULL;
+}
+
+/** Load an identity
+ *
+ * Takes the identity from the prefetcher if it has been or is being
+ * loaded there, otherwise loads it through the loader.
+ */
+static struct QsReflist load( QsPivotGraph g,QsComponent i,struct QsMetadata* meta ) {
+	if( g->prefetch.running ) {
+		pthread_mutex_lock( &g->prefetch.lock );
+
+		struct PrefetchSlot* slot;
+		while( ( slot = prefetch_slot( g,i ) )->state==PREFETCH_LOADING )
+			pthread_cond_wait( &g->prefetch.change,&g->prefetch.lock );
+
+		bool done = slot->state==PREFETCH_DONE;
+		struct QsReflist result = slot->list;
+		*meta = slot->meta;
+
+		if( done )
+			g->prefetch.usage -= reflist_size( result );
+
+		slot->state = PREFETCH_TAKEN;
+
+		pthread_mutex_unlock( &g->prefetch.lock );
+
+		if( done )
+			return result;
+	}
+
+	return g->loader( g->load_data,i,meta );
+}
+
+/** Start lookahead loading
+ *
+ * Spawns a thread which loads the identities of the heads of pivots
+ * passed to qs_pivot_graph_prefetch ahead of time.
+ *
+ * @param This
+ *
+ * @param Depth up to which heads of heads are loaded, 1 meaning only
+ * the immediate heads of a pivot
+ *
+ * @param Limit in bytes of coefficients held by loaded, but unused
+ * identities or 0 for no limit
+ */
+void qs_pivot_graph_prefetch_start( QsPivotGraph g,unsigned depth,size_t limit ) {
+	if( g->prefetch.running || depth==0 )
+		return;
+
+	g->prefetch.depth = depth>UCHAR_MAX?UCHAR_MAX:depth;
+	g->prefetch.limit = limit;
+	g->prefetch.terminate = false;
+
+	if( !pthread_create( &g->prefetch.thread,NULL,(void*(*)( void* ))prefetcher,g ) )
+		g->prefetch.running = true;
+}
+
+/** Request lookahead loading for a pivot
+ *
+ * Queues the heads of the given pivot for loading if lookahead loading
+ * has been started.
+ *
+ * @param This
+ *
+ * @param The pivot whose heads are likely to be considered next
+ */
+void qs_pivot_graph_prefetch( QsPivotGraph g,QsComponent i ) {
+	Pivot* target = pivot_of( g,i );
+
+	if( !g->prefetch.running || !target )
+		return;
+
+	pthread_mutex_lock( &g->prefetch.lock );
+
+	int j;
+	for( j = 0; j<target->n_refs; j++ ) {
+		const QsComponent head = target->refs[ j ].head;
+
+		if( !pivot_of( g,head ) )
+			prefetch_enqueue( g,head,g->prefetch.depth );
+	}
+
+	pthread_mutex_unlock( &g->prefetch.lock );
+}
+
+static void prefetch_stop( QsPivotGraph g ) {
+	if( g->prefetch.running ) {
+		pthread_mutex_lock( &g->prefetch.lock );
+		g->prefetch.terminate = true;
+		pthread_cond_broadcast( &g->prefetch.change );
+		pthread_mutex_unlock( &g->prefetch.lock );
+
+		pthread_join( g->prefetch.thread,NULL );
+		g->prefetch.running = false;
+	}
+
+	int j;
+	for( j = 0; j<g->prefetch.n_pages; j++ ) {
+		struct PrefetchSlot* page = g->prefetch.pages[ j ];
+		if( !page )
+			continue;
+
+		int k;
+		for( k = 0; k<COMPONENT_PAGE_SIZE; k++ )
+			if( page[ k ].state==PREFETCH_DONE )
+				reflist_destroy( page[ k ].list );
+
+		free( page );
+	}
+
+	free( g->prefetch.pages );
+	free( g->prefetch.queue );
+
+	pthread_mutex_destroy( &g->prefetch.lock );
+	pthread_cond_destroy( &g->prefetch.change );
+}
+
+QsPivotGraph qs_pivot_graph_new_with_size( QsAEF aef,QsAEF aef_numeric,void* load_data,QsLoadFunction loader,QsMetaFunction meta_loader,QsFetchFunction fetcher,void* save_data,QsSaveFunction saver,QsDb cstorage,size_t memory_max,unsigned prealloc ) {
 	QsPivotGraph result = malloc( sizeof (struct QsPivotGraph) );
+	result->lru.limit = 0;
+	result->lru.n_pivots = 0;
+	result->lru.first = NULL;
+	result->lru.last = NULL;
+
+	pthread_mutex_init( &result->frontend.lock,NULL );
+	pthread_cond_init( &result->frontend.change,NULL );
+
 	result->n_components = 0;
-	result->allocated = prealloc;
-	result->components = malloc( prealloc*sizeof (Pivot*) );
+	result->n_pages =( prealloc>>COMPONENT_PAGE_BITS )+ 1;
+	result->pages = calloc( result->n_pages,sizeof (Pivot**) );
 	result->loader = loader;
+	result->meta_loader = meta_loader;
+	result->fetcher = fetcher;
 	result->load_data = load_data;
 	result->saver = saver;
 	result->save_data = save_data;
@@ -212,13 +789,41 @@ QsPivotGraph qs_pivot_graph_new_with_size( QsAEF aef,QsAEF aef_numeric,void* loa
 	atomic_init( &result->memory.n_low_ids,0 );
 	atomic_init( &result->memory.n_high_ids,0 );
 	result->memory.queue = qs_terminal_queue_new( );
-	result->memory.initial_mgr = qs_terminal_mgr_new( (QsTerminalLoader)initial_terminal_loader,NULL,NULL,(QsTerminalMemoryCallback)memory_change,result->memory.queue,sizeof (struct CoefficientId),result );
+	result->memory.initial_mgr = qs_terminal_mgr_new( (QsTerminalLoader)initial_terminal_loader,NULL,NULL,(QsTerminalMemoryCallback)memory_change,result->memory.queue,sizeof (union InitialId),result );
 	result->memory.mgr = qs_terminal_mgr_new( (QsTerminalLoader)terminal_loader,(QsTerminalSaver)terminal_saver,(QsTerminalDiscarder)terminal_discarder,(QsTerminalMemoryCallback)memory_change,result->memory.queue,sizeof (struct CoefficientMeta),result );
 	pthread_mutex_init( &result->memory.lock,NULL );
-	pthread_mutex_init( &result->memory.initial_lock,NULL );
 	pthread_mutex_init( &result->memory.terminal_lock,NULL );
 	pthread_mutex_init( &result->memory.initial_terminal_lock,NULL );
 
+	result->storage.n_slabs = 0;
+	result->storage.slabs = malloc( 0 );
+	result->storage.slab_used = 0;
+	result->storage.free_pivots = NULL;
+
+	int j;
+	for( j = 0; j<REFS_CLASSES; j++ )
+		result->storage.free_refs[ j ]= NULL;
+
+	result->grouping.table_bits = 0;
+	result->grouping.table = NULL;
+	result->grouping.allocated = 0;
+	result->grouping.group_of = NULL;
+	result->grouping.group_size = NULL;
+	result->grouping.group_first = NULL;
+	result->grouping.operands = NULL;
+	result->grouping.operands_numeric = NULL;
+
+	result->prefetch.running = false;
+	result->prefetch.usage = 0;
+	result->prefetch.n_pages = 0;
+	result->prefetch.pages = NULL;
+	result->prefetch.queue_begin = 0;
+	result->prefetch.queue_end = 0;
+	result->prefetch.queue_allocated = 0;
+	result->prefetch.queue = NULL;
+	pthread_mutex_init( &result->prefetch.lock,NULL );
+	pthread_cond_init( &result->prefetch.change,NULL );
+
 	result->aef = aef;
 	result->aef_numeric = aef_numeric;
 
@@ -228,70 +833,309 @@ QsPivotGraph qs_pivot_graph_new_with_size( QsAEF aef,QsAEF aef_numeric,void* loa
 	return result;
 }
 
-static void assert_coverage( QsPivotGraph g,QsComponent i ) {
-	if( g->n_components>i )
-		return;
-
-	if( !( g->allocated>i ) ) {
-		fprintf( stderr,"Warning: Preallocated space did not suffice for %i pivots\n",i+1 );
-		g->components = realloc( g->components,( g->allocated = i + 1 )*sizeof (Pivot*) );
-	}
-
+static bool pivot_finished( Pivot* p ) {
 	int j;
-	for( j = g->n_components; !( j>i ); j++ )
-		g->components[ j ]= NULL;
-	
-	g->n_components = i + 1;
+	for( j = 0; j<p->n_refs; j++ )
+		if( !qs_operand_finished( p->refs[ j ].coefficient )|| !qs_operand_finished( p->refs[ j ].numeric ) )
+			return false;
+
+	return true;
 }
 
-static void free_pivot( Pivot* p ) {
+static void free_pivot( QsPivotGraph g,Pivot* p ) {
 	int j;
 	for( j = 0; j<p->n_refs; j++ ) {
 		qs_operand_unref( (QsOperand)p->refs[ j ].coefficient );
 		qs_operand_unref( (QsOperand)p->refs[ j ].numeric );
 	}
 
-	free( p->refs );
-	free( p );
+	for( j = 0; j<p->n_initial; j++ )
+		qs_operand_unref( (QsOperand)p->initial[ j ] );
+
+	free( p->initial );
+
+	refs_free( g,p->refs,p->refs_class );
+
+	*(void**)p = g->storage.free_pivots;
+	g->storage.free_pivots = p;
 }
 
-struct QsMetadata* qs_pivot_graph_meta( QsPivotGraph g,QsComponent i ) {
-	assert_coverage( g,i );
+/** Hand initial coefficients of a pivot over to the backing storage
+ *
+ * Initial coefficients which have been dropped from memory are fetched
+ * from the identity of their tail again, which is only valid until the
+ * identity is overwritten. Before a pivot is saved, its initial
+ * coefficients which are still referenced, e.g. by pending evaluations
+ * of other pivots, are loaded once more and henceforth saved to and
+ * loaded from the backing storage like evaluated coefficients.
+ *
+ * @param This
+ *
+ * @param The pivot which is about to be saved
+ */
+static void initial_spill( QsPivotGraph g,Pivot* p ) {
+	int j;
+	for( j = 0; j<p->n_initial; j++ ) {
+		QsTerminal t = p->initial[ j ];
 
-	if( g->components[ i ] )
-		return &g->components[ i ]->meta;
+		if( qs_operand_shared( (QsOperand)t ) ) {
+			qs_terminal_acquire( t );
 
-	struct QsMetadata meta;
+			/* The initial loader reads the identifier under the lock */
+			struct CoefficientMeta* meta = COEFFICIENT_META_NEW( g );
+			pthread_mutex_lock( &g->memory.initial_terminal_lock );
+			qs_terminal_remanage( t,g->memory.mgr,meta );
+			pthread_mutex_unlock( &g->memory.initial_terminal_lock );
+
+			qs_terminal_release( t );
+		}
+
+		qs_operand_unref( (QsOperand)t );
+	}
+
+	p->n_initial = 0;
+}
+
+/** Unload least recently used pivots
+ *
+ * Saves and unloads pivots from the cold end of the LRU list until
+ * there is room for another one within the limit. Only pivots which are not under
+ * consideration in cks, not owned by a frontend and whose coefficients
+ * have all been evaluated are unloaded. Others are terminated so that
+ * they become eligible later and are put back at the front. At most
+ * EVICT_SCAN pivots are inspected per call.
+ */
+static void evict( QsPivotGraph g ) {
+	unsigned scanned = 0;
+
+	while( g->lru.limit && !( g->lru.n_pivots<g->lru.limit ) && scanned<EVICT_SCAN ) {
+		Pivot* p = g->lru.last;
+		const QsComponent i = p->component;
+
+		lru_unlink( g,p );
+		scanned++;
+
+		const bool idle = p->meta.consideration==0 && p->owner==0;
+
+		if( idle && pivot_finished( p ) ) {
+			qs_pivot_graph_save( g,i );
+			free_pivot( g,p );
+			*pivot_slot( g,i )= NULL;
+		} else {
+			if( idle )
+				qs_pivot_graph_terminate_all( g,i );
+
+			lru_push( g,p );
+		}
+	}
+}
+
+/** Limit the number of loaded pivots
+ *
+ * Once more than the given number of pivots are loaded, the least
+ * recently used ones are written back through the save function and
+ * reloaded on demand by qs_pivot_graph_meta.
+ *
+ * @param This
+ *
+ * @param Number of pivots or 0 for no limit
+ */
+void qs_pivot_graph_limit_pivots( QsPivotGraph g,unsigned limit ) {
+	g->lru.limit = limit;
+}
+
+/** Enter the graph as a frontend
+ *
+ * All functions but the constructor and the destructor must be called
+ * by a frontend which holds the graph.
+ *
+ * @param This
+ */
+void qs_pivot_graph_lock( QsPivotGraph g ) {
+	pthread_mutex_lock( &g->frontend.lock );
+}
+
+/** Leave the graph as a frontend
+ *
+ * Frontends leave the graph while they wait for evaluations, such that
+ * other frontends proceed meanwhile.
+ *
+ * @param This
+ */
+void qs_pivot_graph_unlock( QsPivotGraph g ) {
+	pthread_mutex_unlock( &g->frontend.lock );
+}
+
+/** Take ownership of a pivot
+ *
+ * Only the owner of a pivot may modify it or its order while it waits
+ * for evaluations outside of the graph. The pivot is loaded if
+ * necessary. A frontend must not wait for a pivot while it owns
+ * another, lest two frontends wait for each other.
+ *
+ * @param This
+ *
+ * @param Pivot
+ *
+ * @param Frontend, counting from 1
+ *
+ * @param Whether to wait for another owner to disown the pivot
+ *
+ * @return Whether the frontend owns the pivot
+ */
+bool qs_pivot_graph_own( QsPivotGraph g,QsComponent i,unsigned frontend,bool wait ) {
+	assert( frontend );
+
+	while( true ) {
+		/* The pivot may have been unloaded while we waited */
+		if( !pivot_of( g,i )&& !qs_pivot_graph_meta( g,i ) )
+			return false;
+
+		Pivot* target = pivot_of( g,i );
 
-	pthread_mutex_lock( &g->memory.initial_lock );
+		if( target->owner==0 || target->owner==frontend ) {
+			target->owner = frontend;
+			return true;
+		}
+
+		if( !wait )
+			return false;
+
+		pthread_cond_wait( &g->frontend.change,&g->frontend.lock );
+	}
+}
+
+void qs_pivot_graph_disown( QsPivotGraph g,QsComponent i ) {
+	pivot_of( g,i )->owner = 0;
+	pthread_cond_broadcast( &g->frontend.change );
+}
+
+/** Terminate a pivot for waiting outside of the graph
+ *
+ * Terminates all coefficients of a pivot and yields a reference to
+ * each of them, such that they may be waited for without holding the
+ * graph. Once they are finished, qs_pivot_graph_acquire does not block.
+ * The references remain valid when the pivot changes later on, so they
+ * also serve as a snapshot of the pivot.
+ *
+ * @param This
+ *
+ * @param Pivot
+ *
+ * @param[out] The references, the symbolic and the numeric coefficient
+ * of each edge in turn, to be dropped with qs_operand_unref and freed by
+ * the caller
+ *
+ * @param[out] The head of each edge, to be freed by the caller
+ *
+ * @return Number of references
+ */
+unsigned qs_pivot_graph_terminals( QsPivotGraph g,QsComponent i,QsTerminal** terminals,QsComponent** heads ) {
+	Pivot* target = pivot_of( g,i );
+
+	*terminals = malloc( 0 );
+	*heads = malloc( 0 );
+
+	if( !target )
+		return 0;
+
+	qs_pivot_graph_terminate_all( g,i );
+
+	const unsigned n = 2*target->n_refs;
+	*terminals = realloc( *terminals,n*sizeof (QsTerminal) );
+	*heads = realloc( *heads,target->n_refs*sizeof (QsComponent) );
+
+	int j;
+	for( j = 0; j<target->n_refs; j++ ) {
+		( *terminals )[ 2*j ]= (QsTerminal)qs_operand_ref( target->refs[ j ].coefficient );
+		( *terminals )[ 2*j + 1 ]= (QsTerminal)qs_operand_ref( target->refs[ j ].numeric );
+		( *heads )[ j ]= target->refs[ j ].head;
+	}
+
+	return n;
+}
+
+/** Peek at the metadata of a pivot
+ *
+ * Yields the metadata of a pivot like qs_pivot_graph_meta but does not
+ * load the pivot if it is not loaded yet. The metadata is a copy and
+ * does not follow changes of the pivot.
+ *
+ * @param This
+ *
+ * @param Pivot
+ *
+ * @param[out] Metadata
+ *
+ * @return Whether the pivot exists, i.e. qs_pivot_graph_meta would not
+ * return NULL
+ */
+bool qs_pivot_graph_peek( QsPivotGraph g,QsComponent i,struct QsMetadata* meta ) {
+	struct QsMetadata* loaded;
+
+	if( pivot_of( g,i ) )
+		loaded = &pivot_of( g,i )->meta;
+	else if( g->meta_loader )
+		return g->meta_loader( g->load_data,i,meta );
+	else
+		loaded = qs_pivot_graph_meta( g,i );
+
+	if( loaded )
+		*meta = *loaded;
+
+	return loaded;
+}
+
+struct QsMetadata* qs_pivot_graph_meta( QsPivotGraph g,QsComponent i ) {
+	Pivot** slot = pivot_slot( g,i );
+
+	if( *slot ) {
+		lru_unlink( g,*slot );
+		lru_push( g,*slot );
 
-	struct QsReflist l = g->loader( g->load_data,i,&meta );
+		return &( *slot )->meta;
+	}
 
-	pthread_mutex_unlock( &g->memory.initial_lock );
+	struct QsMetadata meta;
+	struct QsReflist l = load( g,i,&meta );
 
 	if( !l.n_references )
 		return NULL;
 
-	Pivot* result = g->components[ i ]= malloc( sizeof (Pivot) );
-	result->n_refs = l.n_references;
-	result->refs = malloc( l.n_references*sizeof (struct Reference) );
+	/* Make room before the new pivot enters, so that it is not a candidate
+	 * itself */
+	evict( g );
+
+	Pivot* result = *slot = pivot_new( g,l.n_references );
+	result->component = i;
+	result->owner = 0;
 	result->meta = meta;
 
+	/* Without a memory limit, initial coefficients are never dropped and
+	 * thus never reloaded */
+	result->n_initial = g->memory.limit?result->n_refs:0;
+	result->initial = g->memory.limit?malloc( result->n_initial*sizeof (QsTerminal) ):NULL;
+
+	lru_push( g,result );
+
 	int j;
 	for( j = 0; j<result->n_refs; j++ ) {
 		result->refs[ j ].head = l.references[ j ].head;
 
-		struct CoefficientId id = { i,l.references[ j ].head };
+		union InitialId id = { .id = { i,l.references[ j ].head } };
 		QsTerminal coeff = qs_operand_new( g->memory.initial_mgr,&id );
 		qs_terminal_load( coeff,l.references[ j ].coefficient );
 
+		if( result->initial )
+			result->initial[ j ]= (QsTerminal)qs_operand_ref( (QsOperand)coeff );
+
 		result->refs[ j ].coefficient = (QsOperand)coeff;
 		result->refs[ j ].numeric = qs_operand_ref( (QsOperand)coeff );
 	}
 
 	free( l.references );
 
-	return &g->components[ i ]->meta;
+	return &result->meta;
 }
 
 /** Relay an edge
@@ -311,8 +1155,8 @@ struct QsMetadata* qs_pivot_graph_meta( QsPivotGraph g,QsComponent i ) {
  * @return Whether a matching edge was found and relayed
  */
 bool qs_pivot_graph_relay( QsPivotGraph g,QsComponent tail,QsComponent head ) {
-	Pivot* tail_pivot = g->components[ tail ];
-	Pivot* head_pivot = g->components[ head ];
+	Pivot* tail_pivot = pivot_of( g,tail );
+	Pivot* head_pivot = pivot_of( g,head );
 
 	int j;
 	for( j = 0; j<tail_pivot->n_refs; j++ )
@@ -321,7 +1165,7 @@ bool qs_pivot_graph_relay( QsPivotGraph g,QsComponent tail,QsComponent head ) {
 			QsOperand base_numeric = (QsOperand)qs_operand_terminate( tail_pivot->refs[ j ].numeric,g->aef_numeric,NULL,NULL );
 
 			tail_pivot->refs[ j ]= tail_pivot->refs[ tail_pivot->n_refs - 1 ];
-			tail_pivot->refs = realloc( tail_pivot->refs,( tail_pivot->n_refs + head_pivot->n_refs - 2 )*sizeof (struct Reference) );
+			refs_reserve( g,tail_pivot,tail_pivot->n_refs + head_pivot->n_refs - 2 );
 
 			int k;
 			int j_prime = 0;
@@ -344,6 +1188,7 @@ bool qs_pivot_graph_relay( QsPivotGraph g,QsComponent tail,QsComponent head ) {
 			}
 
 			tail_pivot->n_refs += head_pivot->n_refs - 2;
+			tail_pivot->sorted = false;
 
 			if( head_pivot->n_refs>1 )
 				qs_operand_unref( base );
@@ -373,7 +1218,7 @@ bool qs_pivot_graph_relay( QsPivotGraph g,QsComponent tail,QsComponent head ) {
  * @param The head component
  */
 void qs_pivot_graph_collect( QsPivotGraph g,QsComponent tail,QsComponent head ) {
-	Pivot* tail_pivot = g->components[ tail ];
+	Pivot* tail_pivot = pivot_of( g,tail );
 
 	unsigned allocated = COLLECT_PREALLOC;
 	unsigned n_operands = 0;
@@ -386,8 +1231,9 @@ void qs_pivot_graph_collect( QsPivotGraph g,QsComponent tail,QsComponent head )
 	while( j<tail_pivot->n_refs ) {
 		if( tail_pivot->refs[ j ].head==head ) {
 			if( n_operands==allocated ) {
-				operands = realloc( operands,++allocated*sizeof (QsOperand) );
-				operands_numeric = realloc( operands_numeric,++allocated*sizeof (QsOperand) );
+				allocated *= 2;
+				operands = realloc( operands,allocated*sizeof (QsOperand) );
+				operands_numeric = realloc( operands_numeric,allocated*sizeof (QsOperand) );
 			}
 
 			operands[ n_operands ]= tail_pivot->refs[ j ].coefficient;
@@ -396,8 +1242,10 @@ void qs_pivot_graph_collect( QsPivotGraph g,QsComponent tail,QsComponent head )
 			if( n_operands==0 ) {
 				first = j;
 				j++;
-			} else
+			} else {
 				tail_pivot->refs[ j ] = tail_pivot->refs[ --( tail_pivot->n_refs ) ];
+				tail_pivot->sorted = false;
+			}
 
 			n_operands++;
 		} else
@@ -413,15 +1261,289 @@ void qs_pivot_graph_collect( QsPivotGraph g,QsComponent tail,QsComponent head )
 			qs_operand_unref( operands_numeric[ j ] );
 		}
 
-		tail_pivot->refs = realloc( tail_pivot->refs,tail_pivot->n_refs*sizeof (struct Reference) );
+		refs_trim( g,tail_pivot );
 	}
 
 	free( operands );
 	free( operands_numeric );
 }
 
+static void grouping_reserve( QsPivotGraph g,unsigned n ) {
+	if( n>g->grouping.allocated ) {
+		g->grouping.allocated = n;
+		g->grouping.group_of = realloc( g->grouping.group_of,n*sizeof (unsigned) );
+		g->grouping.group_size = realloc( g->grouping.group_size,n*sizeof (unsigned) );
+		g->grouping.group_first = realloc( g->grouping.group_first,n*sizeof (unsigned) );
+		g->grouping.operands = realloc( g->grouping.operands,n*sizeof (QsOperand) );
+		g->grouping.operands_numeric = realloc( g->grouping.operands_numeric,n*sizeof (QsOperand) );
+	}
+}
+
+/** Collects all edges with equal heads
+ *
+ * Equivalent to qs_pivot_graph_collect for every head of the pivot, but
+ * in a single pass. The references are grouped by head in a hash table
+ * and each group of more than one reference is replaced by a single
+ * addition in the place of its first reference.
+ *
+ * @param This
+ *
+ * @param The tail pivot
+ */
+void qs_pivot_graph_collect_all( QsPivotGraph g,QsComponent tail ) {
+	Pivot* tail_pivot = pivot_of( g,tail );
+	const unsigned n = tail_pivot->n_refs;
+
+	if( n<2 )
+		return;
+
+	grouping_reserve( g,n );
+
+	if( ( 1U<<g->grouping.table_bits )<2*n ) {
+		while( ( 1U<<g->grouping.table_bits )<2*n )
+			g->grouping.table_bits++;
+
+		g->grouping.table = realloc( g->grouping.table,( 1U<<g->grouping.table_bits )*sizeof (unsigned) );
+	}
+
+	const unsigned mask =( 1U<<g->grouping.table_bits )- 1;
+	unsigned* table = g->grouping.table;
+	unsigned* group_of = g->grouping.group_of;
+	unsigned* group_size = g->grouping.group_size;
+	unsigned* group_first = g->grouping.group_first;
+
+	unsigned j;
+	for( j = 0; j<=mask; j++ )
+		table[ j ]= GROUP_EMPTY;
+
+	/* Groups are numbered in order of their first reference */
+	unsigned n_groups = 0;
+	for( j = 0; j<n; j++ ) {
+		const QsComponent head = tail_pivot->refs[ j ].head;
+
+		unsigned slot = GROUP_HASH( head,g->grouping.table_bits );
+		while( table[ slot ]!=GROUP_EMPTY && tail_pivot->refs[ group_first[ table[ slot ] ] ].head!=head )
+			slot =( slot + 1 )&mask;
+
+		if( table[ slot ]==GROUP_EMPTY ) {
+			table[ slot ]= n_groups;
+			group_first[ n_groups ]= j;
+			group_size[ n_groups ]= 0;
+			n_groups++;
+		}
+
+		group_of[ j ]= table[ slot ];
+		group_size[ table[ slot ] ]++;
+	}
+
+	if( n_groups==n )
+		return;
+
+	/* Operands of a group are placed contiguously, group_first becomes the
+	 * offset of a group among the operands */
+	unsigned offset = 0;
+	for( j = 0; j<n_groups; j++ ) {
+		const unsigned size = group_size[ j ];
+		group_size[ j ]= offset;
+		offset += size;
+	}
+
+	for( j = 0; j<n; j++ ) {
+		const unsigned k = group_size[ group_of[ j ] ]++;
+		g->grouping.operands[ k ]= tail_pivot->refs[ j ].coefficient;
+		g->grouping.operands_numeric[ k ]= tail_pivot->refs[ j ].numeric;
+	}
+
+	/* Now group_size holds the end offset of every group */
+	unsigned begin = 0;
+	for( j = 0; j<n_groups; j++ ) {
+		const unsigned end = group_size[ j ];
+		struct Reference* target = tail_pivot->refs + j;
+
+		target->head = tail_pivot->refs[ group_first[ j ] ].head;
+
+		if( end - begin>1 ) {
+			target->coefficient = (QsOperand)qs_operand_link( end - begin,g->grouping.operands + begin,QS_OPERATION_ADD );
+			target->numeric = (QsOperand)qs_operand_link( end - begin,g->grouping.operands_numeric + begin,QS_OPERATION_ADD );
+
+			unsigned k;
+			for( k = begin; k<end; k++ ) {
+				qs_operand_unref( g->grouping.operands[ k ] );
+				qs_operand_unref( g->grouping.operands_numeric[ k ] );
+			}
+		} else {
+			target->coefficient = g->grouping.operands[ begin ];
+			target->numeric = g->grouping.operands_numeric[ begin ];
+		}
+
+		begin = end;
+	}
+
+	tail_pivot->n_refs = n_groups;
+	refs_trim( g,tail_pivot );
+}
+
+static int reference_cmp( const void* a,const void* b ) {
+	const QsComponent ha =( (const struct Reference*)a )->head;
+	const QsComponent hb =( (const struct Reference*)b )->head;
+
+	return ha==hb?0:( ha<hb?-1:1 );
+}
+
+static void pivot_sort( Pivot* p ) {
+	if( !p->sorted ) {
+		qsort( p->refs,p->n_refs,sizeof (struct Reference),reference_cmp );
+		p->sorted = true;
+	}
+}
+
+/** Append a term to a merged reference list
+ *
+ * Combines the operands gathered for one head into a single reference.
+ * The operands are consumed.
+ */
+static void merge_emit( struct Reference* target,QsComponent head,unsigned n,QsOperand* operands,QsOperand* operands_numeric ) {
+	target->head = head;
+
+	if( n>1 ) {
+		target->coefficient = (QsOperand)qs_operand_link( n,operands,QS_OPERATION_ADD );
+		target->numeric = (QsOperand)qs_operand_link( n,operands_numeric,QS_OPERATION_ADD );
+
+		int j;
+		for( j = 0; j<n; j++ ) {
+			qs_operand_unref( operands[ j ] );
+			qs_operand_unref( operands_numeric[ j ] );
+		}
+	} else {
+		target->coefficient = operands[ 0 ];
+		target->numeric = operands_numeric[ 0 ];
+	}
+}
+
+/** Relay an edge and collect the result
+ *
+ * Has the same effect as qs_pivot_graph_relay followed by
+ * qs_pivot_graph_collect_all, except that all edges from tail to head are
+ * relayed at once. Both reference lists are brought into order by head,
+ * if they are not already, and the relayed limbs are merged into the
+ * tail, such that terms with equal heads are added as they meet. The
+ * tail remains ordered, so that subsequent relays into the same pivot
+ * need no sorting.
+ *
+ * @param This
+ *
+ * @param Pivot on which to relay the edge
+ *
+ * @param Head of the edge
+ *
+ * @return Whether a matching edge was found and relayed
+ */
+bool qs_pivot_graph_relay_collect( QsPivotGraph g,QsComponent tail,QsComponent head ) {
+	Pivot* tail_pivot = pivot_of( g,tail );
+	Pivot* head_pivot = pivot_of( g,head );
+
+	pivot_sort( tail_pivot );
+
+	/* The run of edges to head */
+	unsigned base_begin = 0;
+	while( base_begin<tail_pivot->n_refs && tail_pivot->refs[ base_begin ].head<head )
+		base_begin++;
+
+	unsigned base_end = base_begin;
+	while( base_end<tail_pivot->n_refs && tail_pivot->refs[ base_end ].head==head )
+		base_end++;
+
+	if( base_begin==base_end )
+		return false;
+
+	pivot_sort( head_pivot );
+
+	const unsigned n_tail = tail_pivot->n_refs;
+	const unsigned n_head = head_pivot->n_refs;
+
+	grouping_reserve( g,n_tail + n_head );
+
+	QsOperand* operands = g->grouping.operands;
+	QsOperand* operands_numeric = g->grouping.operands_numeric;
+
+	unsigned j;
+	for( j = base_begin; j<base_end; j++ ) {
+		operands[ j - base_begin ]= tail_pivot->refs[ j ].coefficient;
+		operands_numeric[ j - base_begin ]= tail_pivot->refs[ j ].numeric;
+	}
+
+	struct Reference base_ref;
+	merge_emit( &base_ref,head,base_end - base_begin,operands,operands_numeric );
+
+	QsOperand base = (QsOperand)qs_operand_terminate( base_ref.coefficient,g->aef,g->memory.mgr,COEFFICIENT_META_NEW( g ) );
+	QsOperand base_numeric = (QsOperand)qs_operand_terminate( base_ref.numeric,g->aef_numeric,NULL,NULL );
+
+	const unsigned char class = refs_class( n_tail + n_head );
+	struct Reference* result = refs_alloc( g,class );
+	unsigned n_result = 0;
+
+	unsigned t = 0;
+	unsigned h = 0;
+	while( t<n_tail || h<n_head ) {
+		/* Skip the relayed edges and the self-edge of the head */
+		if( t==base_begin ) {
+			t = base_end;
+			continue;
+		}
+
+		if( h<n_head && head_pivot->refs[ h ].head==head ) {
+			h++;
+			continue;
+		}
+
+		QsComponent next;
+		if( t<n_tail &&( h==n_head || tail_pivot->refs[ t ].head<=head_pivot->refs[ h ].head ) )
+			next = tail_pivot->refs[ t ].head;
+		else
+			next = head_pivot->refs[ h ].head;
+
+		unsigned n_operands = 0;
+		for( ; t<n_tail && t!=base_begin && tail_pivot->refs[ t ].head==next; t++ ) {
+			operands[ n_operands ]= tail_pivot->refs[ t ].coefficient;
+			operands_numeric[ n_operands ]= tail_pivot->refs[ t ].numeric;
+			n_operands++;
+		}
+
+		for( ; h<n_head && head_pivot->refs[ h ].head==next; h++ ) {
+			QsOperand limb_coefficient = (QsOperand)qs_operand_terminate( head_pivot->refs[ h ].coefficient,g->aef,g->memory.mgr,COEFFICIENT_META_NEW( g ) );
+			head_pivot->refs[ h ].coefficient = limb_coefficient;
+			operands[ n_operands ]= (QsOperand)qs_operand_link( 2,(QsOperand[ ]){ limb_coefficient,base },QS_OPERATION_MUL );
+
+			QsOperand limb_coefficient_numeric = (QsOperand)qs_operand_terminate( head_pivot->refs[ h ].numeric,g->aef_numeric,NULL,NULL );
+			head_pivot->refs[ h ].numeric = limb_coefficient_numeric;
+			operands_numeric[ n_operands ]= (QsOperand)qs_operand_link( 2,(QsOperand[ ]){ limb_coefficient_numeric,base_numeric },QS_OPERATION_MUL );
+
+			n_operands++;
+		}
+
+		merge_emit( result + n_result++,next,n_operands,operands,operands_numeric );
+	}
+
+	refs_free( g,tail_pivot->refs,tail_pivot->refs_class );
+	tail_pivot->refs = result;
+	tail_pivot->refs_class = class;
+	tail_pivot->n_refs = n_result;
+	refs_trim( g,tail_pivot );
+
+	if( n_head>1 )
+		qs_operand_unref( base );
+	else {
+		QsTerminal base_t = qs_operand_terminate( base,g->aef,g->memory.mgr,COEFFICIENT_META_NEW( g ) );
+		qs_operand_discard( base_t,false );
+	}
+
+	qs_operand_unref( base_numeric );
+
+	return true;
+}
+
 QsTerminal qs_pivot_graph_terminate_nth( QsPivotGraph g,QsComponent tail,unsigned n,bool numeric ) {
-	Pivot* target = g->components[ tail ];
+	Pivot* target = pivot_of( g,tail );
 
 	if( numeric )
 		return (QsTerminal)( target->refs[ n ].numeric = (QsOperand)qs_operand_terminate( target->refs[ n ].numeric,g->aef_numeric,NULL,NULL ) );
@@ -430,17 +1552,17 @@ QsTerminal qs_pivot_graph_terminate_nth( QsPivotGraph g,QsComponent tail,unsigne
 }
 
 QsComponent qs_pivot_graph_head_nth( QsPivotGraph g,QsComponent tail,unsigned n ) {
-	assert( g->components[ tail ]->n_refs>n );
-	return g->components[ tail ]->refs[ n ].head;
+	assert( pivot_of( g,tail )->n_refs>n );
+	return pivot_of( g,tail )->refs[ n ].head;
 }
 
 QsOperand qs_pivot_graph_operand_nth( QsPivotGraph g,QsComponent tail,unsigned n,bool numeric ) {
-	assert( g->components[ tail ]->n_refs>n );
-	return numeric?g->components[ tail ]->refs[ n ].numeric:g->components[ tail ]->refs[ n ].coefficient;
+	assert( pivot_of( g,tail )->n_refs>n );
+	return numeric?pivot_of( g,tail )->refs[ n ].numeric:pivot_of( g,tail )->refs[ n ].coefficient;
 }
 
 void qs_pivot_graph_delete_nth( QsPivotGraph g,QsComponent tail,unsigned index_target,unsigned index_replacement ) {
-	Pivot* target = g->components[ tail ];
+	Pivot* target = pivot_of( g,tail );
 
 	target->refs[ index_target ].coefficient = (QsOperand)qs_operand_terminate( target->refs[ index_target ].coefficient,g->aef,g->memory.mgr,COEFFICIENT_META_NEW( g ) );
 
@@ -448,13 +1570,14 @@ void qs_pivot_graph_delete_nth( QsPivotGraph g,QsComponent tail,unsigned index_t
 	qs_operand_unref( target->refs[ index_target ].numeric );
 
 	target->n_refs--;
+	target->sorted = false;
 	target->refs[ index_target ]= target->refs[ index_replacement ];
 	target->refs[ index_replacement ]= target->refs[ target->n_refs ];
-	target->refs = realloc( target->refs,target->n_refs*sizeof (struct Reference) );
+	refs_trim( g,target );
 }
 
 unsigned qs_pivot_graph_n_refs( QsPivotGraph g,QsComponent tail ) {
-	return g->components[ tail ]->n_refs;
+	return pivot_of( g,tail )->n_refs;
 }
 
 /** Normalizes pivotal coefficient
@@ -470,7 +1593,7 @@ unsigned qs_pivot_graph_n_refs( QsPivotGraph g,QsComponent tail ) {
  * @param The target pivot
  */
 void qs_pivot_graph_normalize( QsPivotGraph g,QsComponent target ) {
-	Pivot* target_pivot = g->components[ target ];
+	Pivot* target_pivot = pivot_of( g,target );
 
 	/* If there is only one coefficient, its value is actually irrelevant
 	 * and will be unref'ed without further use. Because QsOperand's unref
@@ -512,7 +1635,7 @@ void qs_pivot_graph_normalize( QsPivotGraph g,QsComponent target ) {
 }
 
 void qs_pivot_graph_terminate_all( QsPivotGraph g,QsComponent i ) {
-	Pivot* target = g->components[ i ];
+	Pivot* target = pivot_of( g,i );
 
 	int j;
 	if( target )
@@ -520,13 +1643,13 @@ void qs_pivot_graph_terminate_all( QsPivotGraph g,QsComponent i ) {
 			target->refs[ j ].coefficient = (QsOperand)qs_operand_terminate( target->refs[ j ].coefficient,g->aef,g->memory.mgr,COEFFICIENT_META_NEW( g ) );
 
 			/* TODO: Very, very ugly - same as QS_OPERAND_ALLOW_DISCARD */
-			target->refs[ j ].numeric = (QsOperand)qs_operand_terminate( target->refs[ j ].numeric,g->aef,NULL,NULL );
+			target->refs[ j ].numeric = (QsOperand)qs_operand_terminate( target->refs[ j ].numeric,g->aef_numeric,NULL,NULL );
 		}
 
 }
 
 void qs_pivot_graph_release( QsPivotGraph g,QsComponent i ) {
-	Pivot* target = g->components[ i ];
+	Pivot* target = pivot_of( g,i );
 
 	int j;
 	for( j = 0; j<target->n_refs; j++ )
@@ -534,7 +1657,7 @@ void qs_pivot_graph_release( QsPivotGraph g,QsComponent i ) {
 }
 
 struct QsReflist qs_pivot_graph_acquire( QsPivotGraph g,QsComponent i ) {
-	Pivot* target = g->components[ i ];
+	Pivot* target = pivot_of( g,i );
 
 	struct QsReflist result = { 0,NULL };
 
@@ -560,6 +1683,7 @@ struct QsReflist qs_pivot_graph_acquire( QsPivotGraph g,QsComponent i ) {
 				qs_operand_unref( target->refs[ j ].numeric );
 				target->refs[ j ]= target->refs[ target->n_refs - 1 ];
 				target->n_refs--;
+				target->sorted = false;
 				result.n_references--;
 			} else
 				j++;
@@ -569,26 +1693,64 @@ struct QsReflist qs_pivot_graph_acquire( QsPivotGraph g,QsComponent i ) {
 	return result;
 }	
 
+/** Save a pivot
+ *
+ * Writes the pivot back through the save function after waiting for all
+ * its coefficients to be evaluated. Its initial coefficients which are
+ * still referenced are handed over to the backing storage before, since
+ * they can no longer be fetched from the identity.
+ *
+ * @param This
+ *
+ * @param The pivot
+ */
 void qs_pivot_graph_save( QsPivotGraph g,QsComponent i ) {
 	struct QsReflist l = qs_pivot_graph_acquire( g,i );
 	if( l.references ) {
-		g->saver( g->save_data,i,l,g->components[ i ]->meta );
+		initial_spill( g,pivot_of( g,i ) );
+		g->saver( g->save_data,i,l,pivot_of( g,i )->meta );
 		free( l.references );
 		qs_pivot_graph_release( g,i );
 	}
 }
 
+/** Save all loaded pivots
+ *
+ * Writes every loaded pivot back through the save function, including
+ * its metadata, after waiting for all its coefficients to be evaluated.
+ * The pivots remain loaded. Since identities remain valid at any stage
+ * of elimination, the saved state is consistent, but this must not be
+ * called while a pivot is being modified.
+ *
+ * @param This
+ */
+void qs_pivot_graph_checkpoint( QsPivotGraph g ) {
+	Pivot* p;
+
+	/* Get all evaluations under way before waiting for any */
+	for( p = g->lru.first; p; p = p->lru_next )
+		qs_pivot_graph_terminate_all( g,p->component );
+
+	for( p = g->lru.first; p; p = p->lru_next )
+		qs_pivot_graph_save( g,p->component );
+}
+
 void qs_pivot_graph_destroy( QsPivotGraph g ) {
+	prefetch_stop( g );
+
 	int j;
 	for( j = 0; j<g->n_components; j++ )
 		qs_pivot_graph_terminate_all( g,j );
 
 	for( j = 0; j<g->n_components; j++ )
-		if( g->components[ j ] ) {
+		if( pivot_of( g,j ) ) {
 			qs_pivot_graph_save( g,j );
-			free_pivot( g->components[ j ] );
+			free_pivot( g,pivot_of( g,j ) );
 		}
 
+	for( j = 0; j<g->n_pages; j++ )
+		free( g->pages[ j ] );
+
 	assert( g->memory.usage==0 );
 
 	qs_terminal_mgr_destroy( g->memory.mgr );
@@ -597,6 +1759,20 @@ void qs_pivot_graph_destroy( QsPivotGraph g ) {
 
 	qs_operand_unref( g->one );
 
-	free( g->components );
+	for( j = 0; j<g->storage.n_slabs; j++ )
+		free( g->storage.slabs[ j ] );
+
+	free( g->storage.slabs );
+	free( g->grouping.table );
+	free( g->grouping.group_of );
+	free( g->grouping.group_size );
+	free( g->grouping.group_first );
+	free( g->grouping.operands );
+	free( g->grouping.operands_numeric );
+	free( g->pages );
+
+	pthread_mutex_destroy( &g->frontend.lock );
+	pthread_cond_destroy( &g->frontend.change );
+
 	free( g );
 }
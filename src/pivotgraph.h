@@ -23,21 +23,65 @@ struct QsReflist {
 	struct QsReference* references;
 };
 
+/** Callback for loading an identity
+ *
+ * Invoked from the frontend as well as from evaluation workers which
+ * reload evicted initial coefficients. It may be called concurrently
+ * and must be thread-safe, as is qs_integral_mgr_load_expression.
+ */
 typedef struct QsReflist(* QsLoadFunction)( void*,QsComponent,struct QsMetadata* );
+/** Callback for loading the metadata of an identity
+ *
+ * Yields the metadata which the QsLoadFunction would yield, preferably
+ * without loading the identity. Invoked with the data of the
+ * QsLoadFunction.
+ *
+ * @return Whether there is an identity, i.e. the QsLoadFunction would
+ * not yield an empty QsReflist
+ */
+typedef bool(* QsMetaFunction)( void*,QsComponent,struct QsMetadata* );
+/** Callback for loading a single coefficient of an identity
+ *
+ * Yields the coefficient which the QsLoadFunction would yield for the
+ * reference to a given head, preferably without loading the other
+ * coefficients. Invoked with the data of the QsLoadFunction and
+ * subject to the same thread-safety requirements.
+ *
+ * @param Data
+ *
+ * @param Component of the identity
+ *
+ * @param Component of the head
+ *
+ * @return The coefficient or NULL
+ */
+typedef QsCoefficient(* QsFetchFunction)( void*,QsComponent,QsComponent );
 typedef void(* QsSaveFunction)( void*,QsComponent,struct QsReflist,struct QsMetadata );
 
 typedef struct QsPivotGraph* QsPivotGraph;
 
-QsPivotGraph qs_pivot_graph_new_with_size( QsAEF,QsAEF,void*,QsLoadFunction,void*,QsSaveFunction,QsDb,size_t,unsigned );
+QsPivotGraph qs_pivot_graph_new_with_size( QsAEF,QsAEF,void*,QsLoadFunction,QsMetaFunction,QsFetchFunction,void*,QsSaveFunction,QsDb,size_t,unsigned );
 struct QsReflist qs_pivot_graph_acquire( QsPivotGraph,QsComponent );
 void qs_pivot_graph_release( QsPivotGraph,QsComponent );
 void qs_pivot_graph_destroy( QsPivotGraph );
+void qs_pivot_graph_prefetch_start( QsPivotGraph,unsigned,size_t );
+void qs_pivot_graph_prefetch( QsPivotGraph,QsComponent );
+void qs_pivot_graph_limit_pivots( QsPivotGraph,unsigned );
+void qs_pivot_graph_lock( QsPivotGraph );
+void qs_pivot_graph_unlock( QsPivotGraph );
+bool qs_pivot_graph_own( QsPivotGraph,QsComponent,unsigned,bool );
+void qs_pivot_graph_disown( QsPivotGraph,QsComponent );
+unsigned qs_pivot_graph_terminals( QsPivotGraph,QsComponent,QsTerminal**,QsComponent** );
 void qs_pivot_graph_save( QsPivotGraph,QsComponent );
+void qs_pivot_graph_checkpoint( QsPivotGraph );
 QsTerminal qs_pivot_graph_terminate( QsPivotGraph,QsComponent,QsComponent );
 void qs_pivot_graph_terminate_all( QsPivotGraph,QsComponent );
 struct QsMetadata* qs_pivot_graph_meta( QsPivotGraph,QsComponent );
+bool qs_pivot_graph_peek( QsPivotGraph,QsComponent,struct QsMetadata* );
 bool qs_pivot_graph_relay( QsPivotGraph,QsComponent,QsComponent );
 void qs_pivot_graph_collect( QsPivotGraph,QsComponent,QsComponent );
+void qs_pivot_graph_collect_all( QsPivotGraph,QsComponent );
+bool qs_pivot_graph_relay_collect( QsPivotGraph,QsComponent,QsComponent );
 void qs_pivot_graph_normalize( QsPivotGraph,QsComponent );
 unsigned qs_pivot_graph_n_refs( QsPivotGraph,QsComponent );
 QsComponent qs_pivot_graph_head_nth( QsPivotGraph,QsComponent,unsigned );
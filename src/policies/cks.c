@@ -1,9 +1,63 @@
 #include <unistd.h>
 
-enum Elimination {
-	ELIMINATE_WAIT,
-	ELIMINATE_OPTIMISTIC,
-	ELIMINATE_NONE
+#include "policy.h"
+
+#define CKS_PREALLOC_FRAMES 16
+
+/** Outcome of running a solve
+ */
+enum CKSStatus {
+	CKS_DONE,
+	CKS_BLOCKED_EVALUATION, ///< Waiting for the evaluations in the blocker
+	CKS_BLOCKED_OWNER ///< Waiting for a pivot owned by another frontend
+};
+
+/** An edge found ready for elimination
+ */
+struct CKSCandidate {
+	QsComponent head;
+	unsigned order; ///< Order of the head
+	size_t size; ///< Text size of the coefficients of the edge evaluated so far
+};
+
+/** Cost of eliminating an edge
+ *
+ * Among the edges found ready at once, the one of least cost is
+ * eliminated, the one of lower order on a tie.
+ */
+typedef unsigned long(* CKSScore)( const struct CKSCandidate* );
+
+/** Where a frame of the elimination resumes
+ */
+enum CKSPhase {
+	PHASE_ACQUIRE, ///< Own the target of the solve
+	PHASE_BEGIN, ///< Start looking for the next elimination
+	PHASE_SCAN, ///< Wait for the numeric coefficients of suitable edges
+	PHASE_ZEROES, ///< Delete edges which are also symbolically zero
+	PHASE_DESCEND, ///< Own the next pivot and solve for it
+	PHASE_RETURN, ///< The next pivot was solved for, own the current one again
+	PHASE_RECLAIM, ///< Wait for the current pivot owned by another frontend
+	PHASE_NORMALIZE ///< Wait for the self-coefficient
+};
+
+/** Elimination in one pivot
+ *
+ * Takes the place of a call of the former recursive solver. Eliminating
+ * an edge pushes a frame for its head.
+ */
+struct CKSFrame {
+	QsComponent i;
+	QS_DESPAIR despair;
+	enum CKSPhase phase;
+	struct QsMetadata* meta;
+
+	int j; ///< Next edge to be looked at
+	QsTerminalGroup waiter;
+	QsTerminalGroup symbolic_waiter;
+
+	QsComponent next_i;
+	struct QsMetadata* next_meta;
+	QsTerminal self;
 };
 
 struct CKSInfo {
@@ -11,49 +65,181 @@ struct CKSInfo {
 	volatile sig_atomic_t terminate;
 	enum Elimination elimination;
 	unsigned rd;
+	unsigned frontend; ///< Owner of the pivots eliminated in, counting from 1
+	CKSScore score; ///< Choice among ready edges or NULL for the first one
+	unsigned width; ///< Number of ready edges relayed per scan, see add_eager
+	unsigned n_considered;
+	QS_DESPAIR* considered; ///< Consideration by this frontend, by component
+
+	unsigned n_frames;
+	unsigned allocated_frames;
+	struct CKSFrame* frames; ///< Stack of the elimination in progress
+	QsTerminalGroup blocker; ///< Evaluations a blocked solve waits for
+	QsComponent awaited; ///< Pivot a blocked solve waits to own
+
+	unsigned n_eager;
+	QsComponent* eager; ///< Solved heads of further ready edges relayed along, up to width - 1
 };
 
-static unsigned index_by_operand( QsPivotGraph g,QsComponent i,QsOperand o,bool numeric ) {
-	unsigned j;
-	for( j = 0; j<qs_pivot_graph_n_refs( g,i ); j++ )
-		if( qs_pivot_graph_operand_nth( g,i,j,numeric )==o )
-			return j;
+/** Consideration of a pivot by this frontend
+ *
+ * The consideration in the metadata counts all frontends and keeps
+ * pivots from eviction. Whether to recurse only depends on the
+ * recursion of this frontend, otherwise pivots which are solved for by
+ * another frontend would remain in the solution.
+ */
+static QS_DESPAIR considered( struct CKSInfo* info,QsComponent i ) {
+	return i<info->n_considered ? info->considered[ i ] : 0;
+}
+
+static void consider( struct CKSInfo* info,QsComponent i,struct QsMetadata* meta,int change ) {
+	if( i>=info->n_considered ) {
+		unsigned n = i + 1>2*info->n_considered ? i + 1 : 2*info->n_considered;
+		info->considered = realloc( info->considered,n*sizeof (QS_DESPAIR) );
+		memset( info->considered + info->n_considered,0,( n - info->n_considered )*sizeof (QS_DESPAIR) );
+		info->n_considered = n;
+	}
 
-	assert( false );
+	info->considered[ i ]+= change;
+	meta->consideration += change;
 }
 
-static void cks( struct CKSInfo* info,QsComponent i,QS_DESPAIR despair ) {
-	struct QsMetadata* meta = qs_pivot_graph_meta( info->graph,i );
+/** Markowitz-like cost
+ *
+ * Every reference the elimination adds to the tail is multiplied by the
+ * coefficient of the edge, so the cost grows with its size. The
+ * references of the head would only be known for heads which are
+ * loaded. They are left out for every edge alike, since counting them
+ * for some edges only would favour the others.
+ */
+unsigned long cks_score_markowitz( const struct CKSCandidate* c ) {
+	return c->size;
+}
 
-	struct QsMetadata* next_meta = NULL;
-	unsigned next_i;
+/** Describe an edge found ready
+ *
+ * Only looks at the edge itself and the metadata of the head, such that
+ * every edge is described alike at constant cost, without loading the
+ * head.
+ */
+static struct CKSCandidate candidate( struct CKSInfo* info,QsComponent i,unsigned j,QsTerminal numeric ) {
+	struct CKSCandidate result;
+	result.head = qs_pivot_graph_head_nth( info->graph,i,j );
+
+	/* The edge was suitable, so the head exists */
+	struct QsMetadata head_meta;
+	qs_pivot_graph_peek( info->graph,result.head,&head_meta );
+	result.order = head_meta.order;
+
+	result.size = qs_coefficient_size( qs_terminal_acquire( numeric ) );
+	qs_terminal_release( numeric );
+
+	/* The symbolic coefficient counts only if it is at hand */
+	QsOperand symbolic = qs_pivot_graph_operand_nth( info->graph,i,j,false );
+	if( qs_operand_finished( symbolic )&& qs_terminal_acquired( (QsTerminal)symbolic ) ) {
+		result.size += qs_coefficient_size( qs_terminal_acquire( (QsTerminal)symbolic ) );
+		qs_terminal_release( (QsTerminal)symbolic );
+	}
+
+	return result;
+}
+
+/** Remember a further ready edge for eager relay
+ *
+ * Only edges to solved heads are relayed along with the chosen one,
+ * since they need no recursion. Edges to heads not solved yet are not
+ * eliminated speculatively, they are found again by the next scan.
+ */
+static void add_eager( struct CKSInfo* info,QsComponent i,unsigned j ) {
+	const QsComponent head = qs_pivot_graph_head_nth( info->graph,i,j );
+
+	struct QsMetadata head_meta;
+	if( info->n_eager + 1<info->width && qs_pivot_graph_peek( info->graph,head,&head_meta )&& head_meta.solved )
+		info->eager[ info->n_eager++ ]= head;
+}
+
+/** Relay the solved heads of further ready edges
+ *
+ * The current pivot is owned. Heads which are no longer solved or
+ * owned by another frontend meanwhile are left to later eliminations.
+ */
+static void relay_eager( struct CKSInfo* info,struct CKSFrame* f ) {
+	for( unsigned k = 0; k<info->n_eager; k++ ) {
+		const QsComponent head = info->eager[ k ];
+		struct QsMetadata* head_meta = qs_pivot_graph_meta( info->graph,head );
+
+		if( !head_meta->solved || !qs_pivot_graph_own( info->graph,head,info->frontend,false ) )
+			continue;
+
+		DBG_PRINT_2( " Relaying ready pivot %i along\n",info->rd,head_meta->order );
+		qs_pivot_graph_relay_collect( info->graph,f->i,head );
+		qs_pivot_graph_disown( info->graph,head );
+	}
+
+	info->n_eager = 0;
+}
 
-	QsTerminalGroup waiter = qs_terminal_group_new( qs_pivot_graph_n_refs( info->graph,i ) );
-	QsTerminalGroup symbolic_waiter = qs_terminal_group_new( 1 );
+static struct CKSFrame* push_frame( struct CKSInfo* info,QsComponent i,QS_DESPAIR despair,enum CKSPhase phase ) {
+	if( info->n_frames==info->allocated_frames ) {
+		info->allocated_frames = info->allocated_frames ? 2*info->allocated_frames : CKS_PREALLOC_FRAMES;
+		info->frames = realloc( info->frames,info->allocated_frames*sizeof (struct CKSFrame) );
+	}
 
-	DBG_PRINT_2( "Determining next elimination among %i edges in %i {\n",info->rd,qs_pivot_graph_n_refs( info->graph,i ),meta->order );
-	int j = 0;
-	while( !next_meta &&( j<qs_pivot_graph_n_refs( info->graph,i )|| qs_terminal_group_count( waiter ) ) ) {
-		if( j<qs_pivot_graph_n_refs( info->graph,i ) ) {
-			QsComponent candidate_i = qs_pivot_graph_head_nth( info->graph,i,j );
-			struct QsMetadata* candidate_meta = qs_pivot_graph_meta( info->graph,candidate_i );
+	struct CKSFrame* result = info->frames + info->n_frames++;
+	result->i = i;
+	result->despair = despair;
+	result->phase = phase;
+	result->meta = qs_pivot_graph_meta( info->graph,i );
 
-			const bool suitable = candidate_i!=i && candidate_meta &&( ( candidate_meta->solved ||( candidate_meta->order<meta->order && candidate_meta->consideration==0 ) )||( despair &&( despair>=candidate_meta->consideration ) ) );
+	return result;
+}
 
-			if( candidate_meta )
-				DBG_PRINT_2( " Edge #%i to pivot %i (%i-fold considered, despair %i)\n",info->rd,j,candidate_meta->order,candidate_meta->consideration,despair );
+/** Look for the next elimination
+ *
+ * Pushes the numeric coefficients of all suitable edges and takes the
+ * first one found not to be zero or, given a score, the cheapest of
+ * those found ready at the same time.
+ *
+ * @return Whether the scan is complete, otherwise the evaluations of the
+ * waiter are pending
+ */
+static bool scan( struct CKSInfo* info,struct CKSFrame* f ) {
+	const QsComponent i = f->i;
+
+	while( !f->next_meta &&( f->j<qs_pivot_graph_n_refs( info->graph,i )|| qs_terminal_group_count( f->waiter ) ) ) {
+		if( f->j<qs_pivot_graph_n_refs( info->graph,i ) ) {
+			QsComponent candidate_i = qs_pivot_graph_head_nth( info->graph,i,f->j );
+			/* Candidates are only loaded once they are chosen, neither checking
+			 * nor scoring them loads them */
+			struct QsMetadata candidate_meta;
+			const bool candidate_exists = qs_pivot_graph_peek( info->graph,candidate_i,&candidate_meta );
+
+			const QS_DESPAIR consideration = considered( info,candidate_i );
+			const bool suitable = candidate_i!=i && candidate_exists &&( ( candidate_meta.solved ||( candidate_meta.order<f->meta->order && consideration==0 ) )||( f->despair &&( f->despair>=consideration ) ) );
+
+			if( candidate_exists )
+				DBG_PRINT_2( " Edge #%i to pivot %i (%i-fold considered, despair %i)\n",info->rd,f->j,candidate_meta.order,consideration,f->despair );
 
 			if( suitable )
-				qs_terminal_group_push( waiter,qs_pivot_graph_terminate_nth( info->graph,i,j,true ) );
+				qs_terminal_group_push_tagged( f->waiter,qs_pivot_graph_terminate_nth( info->graph,i,f->j,true ),f->j );
+
+			f->j++;
+		}
 
-			j++;
-		} else
-			qs_terminal_group_wait( waiter );
+		/* With a score, all edges found ready at once compete, so they are
+		 * all pushed before any is taken */
+		if( info->score && f->j<qs_pivot_graph_n_refs( info->graph,i ) )
+			continue;
 
-		QsTerminal finished = qs_terminal_group_pop( waiter );
+		bool chosen = false;
+		unsigned chosen_j = 0;
+		struct CKSCandidate best;
+		unsigned long best_score = 0;
 
-		if( finished ) {
-			unsigned finished_j = index_by_operand( info->graph,i,(QsOperand)finished,true );
+		/* Pending edges are tagged with their index */
+		unsigned finished_j;
+		QsTerminal finished;
+		while( ( !chosen || info->score || info->n_eager + 1<info->width )&&( finished = qs_terminal_group_pop_tagged( f->waiter,&finished_j ) ) ) {
 			DBG_PRINT_2( " Edge #%i found ready\n",info->rd,finished_j );
 
 			bool is_zero = qs_coefficient_is_zero( qs_terminal_acquire( finished ) );
@@ -62,134 +248,412 @@ static void cks( struct CKSInfo* info,QsComponent i,QS_DESPAIR despair ) {
 			if( is_zero ) {
 				if( info->elimination==ELIMINATE_OPTIMISTIC ) {
 					DBG_PRINT_2( " Found numerically zero and optimistically removed\n",info->rd );
-					qs_pivot_graph_delete_nth( info->graph,i,finished_j,j<qs_pivot_graph_n_refs( info->graph,i )?j-1:0 );
-					j--;
+					/* The last edge looked at takes the place of the deleted one
+					 * and the first edge not looked at takes its place */
+					qs_pivot_graph_delete_nth( info->graph,i,finished_j,f->j - 1 );
+					qs_terminal_group_retag( f->waiter,f->j - 1,finished_j );
+					if( chosen && chosen_j==f->j - 1 )
+						chosen_j = finished_j;
+					f->j--;
 				} else {
 					DBG_PRINT_2( " Found numerically zero and registered for later check\n",info->rd );
-					qs_terminal_group_push( symbolic_waiter,qs_pivot_graph_terminate_nth( info->graph,i,finished_j,false ) );
+					qs_terminal_group_push_tagged( f->symbolic_waiter,qs_pivot_graph_terminate_nth( info->graph,i,finished_j,false ),finished_j );
+				}
+			} else if( !info->score ) {
+				if( chosen )
+					add_eager( info,i,finished_j );
+				else {
+					chosen = true;
+					chosen_j = finished_j;
 				}
 			} else {
-				next_i = qs_pivot_graph_head_nth( info->graph,i,finished_j );
-				next_meta = qs_pivot_graph_meta( info->graph,next_i );
-				DBG_PRINT_2( " Confirmed next elimination to pivot %i\n",info->rd,next_meta->order );
+				const struct CKSCandidate c = candidate( info,i,finished_j,finished );
+				const unsigned long score = info->score( &c );
+				DBG_PRINT_2( " Edge to pivot %i scored %lu\n",info->rd,c.order,score );
+
+				if( !chosen || score<best_score ||( score==best_score && c.order<best.order ) ) {
+					if( chosen )
+						add_eager( info,i,chosen_j );
+
+					chosen = true;
+					chosen_j = finished_j;
+					best = c;
+					best_score = score;
+				} else
+					add_eager( info,i,finished_j );
 			}
 		}
+
+		if( chosen ) {
+			f->next_i = qs_pivot_graph_head_nth( info->graph,i,chosen_j );
+			f->next_meta = qs_pivot_graph_meta( info->graph,f->next_i );
+			DBG_PRINT_2( " Confirmed next elimination to pivot %i\n",info->rd,f->next_meta->order );
+		} else if( f->j>=qs_pivot_graph_n_refs( info->graph,i ) )
+			return false;
 	}
-	DBG_PRINT_2( "}\n",info->rd );
 
-	DBG_PRINT_2( "Attempting to delete symbolically evaluated zeroes {\n",info->rd );
-	QsTerminal finished;
-	while( !next_meta && qs_terminal_group_count( symbolic_waiter )&&( info->elimination==ELIMINATE_WAIT &&( qs_terminal_group_wait( symbolic_waiter ),true ),finished = qs_terminal_group_pop( symbolic_waiter ) ) ) {
-		unsigned finished_j = index_by_operand( info->graph,i,(QsOperand)finished,false );
+	return true;
+}
+
+/** Delete edges found numerically zero
+ *
+ * @return Whether all symbolic zeroes were dealt with, otherwise the
+ * evaluations of the symbolic waiter are pending
+ */
+static bool delete_zeroes( struct CKSInfo* info,struct CKSFrame* f ) {
+	const QsComponent i = f->i;
+
+	while( !f->next_meta && qs_terminal_group_count( f->symbolic_waiter ) ) {
+		unsigned finished_j;
+		QsTerminal finished = qs_terminal_group_pop_tagged( f->symbolic_waiter,&finished_j );
+
+		if( !finished ) {
+			if( info->elimination==ELIMINATE_WAIT )
+				return false;
+
+			break;
+		}
 
 		bool is_zero = qs_coefficient_is_zero( qs_terminal_acquire( finished ) );
 		qs_terminal_release( finished );
 
 		if( is_zero ) {
 			DBG_PRINT_2( " Operand confirmed zero and edge delete\n",info->rd );
-			qs_pivot_graph_delete_nth( info->graph,i,finished_j,0 );
+			const unsigned last = qs_pivot_graph_n_refs( info->graph,i )- 1;
+			qs_pivot_graph_delete_nth( info->graph,i,finished_j,last );
+			qs_terminal_group_retag( f->symbolic_waiter,last,finished_j );
 		} else {
 			DBG_PRINT_2( " Operand is a false zero, edge retained\n",info->rd );
-			fprintf( stderr,"Warning: Numeric cancellation on edge of pivot %i\n",meta->order );
+			fprintf( stderr,"Warning: Numeric cancellation on edge of pivot %i\n",f->meta->order );
 		}
 	}
 
-	if( !next_meta && qs_terminal_group_count( symbolic_waiter ) )
-		fprintf( stderr,"Warning: Unverified numeric zero remain in pivot %i\n",meta->order );
+	if( !f->next_meta && qs_terminal_group_count( f->symbolic_waiter ) )
+		fprintf( stderr,"Warning: Unverified numeric zero remain in pivot %i\n",f->meta->order );
 
-	DBG_PRINT_2( "}\n",info->rd );
+	return true;
+}
 
-	qs_terminal_group_destroy( waiter );
-	qs_terminal_group_destroy( symbolic_waiter );
+/** Solve until done or blocked
+ *
+ * Runs the elimination on the explicit stack of the info. Whenever it
+ * would block, the state is retained and the reason returned, such that
+ * the frontend may proceed with other solves and continue this one
+ * later. The frontend must hold the graph.
+ *
+ * @param This
+ * @return CKS_DONE if the solve is complete, otherwise what it waits
+ * for, c.f. cks_wait
+ */
+enum CKSStatus cks_continue( struct CKSInfo* info ) {
+	while( info->n_frames ) {
+		struct CKSFrame* f = info->frames + info->n_frames - 1;
+		const QsComponent i = f->i;
+
+		switch( f->phase ) {
+		case PHASE_ACQUIRE:
+			if( !qs_pivot_graph_own( info->graph,i,info->frontend,false ) ) {
+				info->awaited = i;
+				return CKS_BLOCKED_OWNER;
+			}
 
-	if( info->terminate )
-		return;
+			info->rd++;
+			f->phase = PHASE_BEGIN;
+			break;
 
-	/* A non-null coefficient was found ready in the info->waiter array */
-	if( next_meta ) {
-		meta->solved = false;
-		meta->touched = false;
-
-		DBG_PRINT( "Eliminating %i from %i {\n",info->rd,next_meta->order,meta->order );
-
-		info->rd++;
-		next_meta->consideration++;
-		cks( info,next_i,0 );
-		next_meta->consideration--;
-		info->rd--;
-
-		DBG_PRINT( "}\n",info->rd );
-
-		/* If termination was requested, the solver possibly returned
-		 * without normalization and we may not attempt to relay the pivot
-		 */
-		if( info->terminate )
-			return;
-
-		/* Further desperate recursions may have touched and modified the
-		 * current target, in which case the current data is obsolete. */
-		if( !meta->touched ) {
-			/* We bake neither the relay nor the collect, because we will
-			 * eventually bake the current pivot on normalize. */
-			qs_pivot_graph_relay( info->graph,i,next_i );
-
-			DBG_PRINT_2( "Collecting %i operands\n",info->rd,qs_pivot_graph_n_refs( info->graph,i ) );
-			for( j = 0; j<qs_pivot_graph_n_refs( info->graph,i ); j++ )
-				qs_pivot_graph_collect( info->graph,i,qs_pivot_graph_head_nth( info->graph,i,j ) );
-		}
+		case PHASE_BEGIN:
+			qs_pivot_graph_prefetch( info->graph,i );
+
+			f->next_meta = NULL;
+			f->j = 0;
+			info->n_eager = 0;
+			f->waiter = qs_terminal_group_new( qs_pivot_graph_n_refs( info->graph,i ) );
+			f->symbolic_waiter = qs_terminal_group_new( 1 );
+
+			DBG_PRINT_2( "Determining next elimination among %i edges in %i {\n",info->rd,qs_pivot_graph_n_refs( info->graph,i ),f->meta->order );
+			f->phase = PHASE_SCAN;
+			break;
+
+		case PHASE_SCAN:
+			if( !scan( info,f ) ) {
+				info->blocker = f->waiter;
+				return CKS_BLOCKED_EVALUATION;
+			}
+
+			DBG_PRINT_2( "}\n",info->rd );
+			DBG_PRINT_2( "Attempting to delete symbolically evaluated zeroes {\n",info->rd );
+			f->phase = PHASE_ZEROES;
+			break;
+
+		case PHASE_ZEROES:
+			if( !delete_zeroes( info,f ) ) {
+				info->blocker = f->symbolic_waiter;
+				return CKS_BLOCKED_EVALUATION;
+			}
+
+			DBG_PRINT_2( "}\n",info->rd );
+
+			qs_terminal_group_destroy( f->waiter );
+			qs_terminal_group_destroy( f->symbolic_waiter );
+
+			if( info->terminate ) {
+				info->n_frames--;
+				break;
+			}
+
+			/* A non-null coefficient was found ready in the waiter */
+			if( f->next_meta ) {
+				relay_eager( info,f );
+
+				/* The next pivot is not considered yet, so waiting for zeroes
+				 * or loading the eagerly relayed heads may have unloaded it */
+				f->next_meta = qs_pivot_graph_meta( info->graph,f->next_i );
+
+				f->meta->solved = false;
+				f->meta->touched = false;
+
+				DBG_PRINT( "Eliminating %i from %i {\n",info->rd,f->next_meta->order,f->meta->order );
+
+				info->rd++;
+				consider( info,f->next_i,f->next_meta,1 );
+
+				/* A frontend owns only the pivot it eliminates in, such that it
+				 * never waits while owning another */
+				qs_pivot_graph_disown( info->graph,i );
+				f->phase = PHASE_DESCEND;
+			} else if( !f->meta->solved ) {
+				/* If we ended up here because of back-substitution, solving is
+				 * true but if we haven't made any changes, solved is still true */
+				int j_self;
+				for( j_self = 0; j_self<qs_pivot_graph_n_refs( info->graph,i ); j_self++ )
+					if( qs_pivot_graph_head_nth( info->graph,i,j_self )==i )
+						break;
+
+				if( j_self<qs_pivot_graph_n_refs( info->graph,i ) ) {
+					DBG_PRINT( "Normalizing %i for substitution\n",info->rd,f->meta->order );
+					qs_pivot_graph_terminate_nth( info->graph,i,j_self,true );
+
+					f->self = (QsTerminal)qs_pivot_graph_operand_nth( info->graph,i,j_self,true );
+				} else
+					f->self = NULL;
+
+				f->waiter = NULL;
+				f->phase = PHASE_NORMALIZE;
+			} else
+				info->n_frames--;
+			break;
+
+		case PHASE_DESCEND:
+			if( !qs_pivot_graph_own( info->graph,f->next_i,info->frontend,false ) ) {
+				info->awaited = f->next_i;
+				return CKS_BLOCKED_OWNER;
+			}
+
+			f->phase = PHASE_RETURN;
+			push_frame( info,f->next_i,0,PHASE_BEGIN );
+			break;
+
+		case PHASE_RETURN:
+			info->rd--;
+			DBG_PRINT( "}\n",info->rd );
 
-		meta->touched = true;
+			/* Keep the next pivot for the relay, unless the current one is
+			 * owned by another frontend */
+			if( !qs_pivot_graph_own( info->graph,i,info->frontend,false ) ) {
+				qs_pivot_graph_disown( info->graph,f->next_i );
+				f->phase = PHASE_RECLAIM;
+				break;
+			}
+			/* fall through */
+
+		case PHASE_RECLAIM:
+			if( f->phase==PHASE_RECLAIM && !qs_pivot_graph_own( info->graph,i,info->frontend,false ) ) {
+				info->awaited = i;
+				return CKS_BLOCKED_OWNER;
+			}
 
-		cks( info,i,despair );
-	} else {
-		/* If we ended up here because of back-substitution, solving is true
-		 * but if we haven't made any changes, solved is still true */
-		if( !meta->solved ) {
-			int j_self;
-			for( j_self = 0; j_self<qs_pivot_graph_n_refs( info->graph,i ); j_self++ )
-				if( qs_pivot_graph_head_nth( info->graph,i,j_self )==i )
+			{
+				const bool relayable = f->phase==PHASE_RETURN || qs_pivot_graph_own( info->graph,f->next_i,info->frontend,false );
+
+				/* If termination was requested, the solver possibly returned
+				 * without normalization and we may not attempt to relay the
+				 * pivot */
+				if( info->terminate ) {
+					if( relayable )
+						qs_pivot_graph_disown( info->graph,f->next_i );
+
+					consider( info,f->next_i,f->next_meta,-1 );
+					info->n_frames--;
 					break;
-				
-			if( j_self<qs_pivot_graph_n_refs( info->graph,i ) ) {
-				DBG_PRINT( "Normalizing %i for substitution\n",info->rd,meta->order );
-				qs_pivot_graph_terminate_nth( info->graph,i,j_self,true );
+				}
 
-				QsTerminal self = (QsTerminal)qs_pivot_graph_operand_nth( info->graph,i,j_self,true );
+				/* Further desperate recursions or other frontends may have
+				 * touched and modified the current target, in which case the
+				 * current data is obsolete. Other frontends may also have
+				 * resumed elimination in the next pivot. */
+				if( !f->meta->touched && relayable && f->next_meta->solved ) {
+					/* We bake neither the relay nor the collect, because we will
+					 * eventually bake the current pivot on normalize. */
+					qs_pivot_graph_relay_collect( info->graph,i,f->next_i );
+					/* Another frontend may have normalized meanwhile */
+					f->meta->solved = false;
+
+					DBG_PRINT_2( "Collected into %i operands\n",info->rd,qs_pivot_graph_n_refs( info->graph,i ) );
+				}
+
+				if( relayable )
+					qs_pivot_graph_disown( info->graph,f->next_i );
 
-				bool is_zero = qs_coefficient_is_zero( qs_terminal_acquire( qs_terminal_wait( self ) ) );
-				qs_terminal_release( self );
+				consider( info,f->next_i,f->next_meta,-1 );
+				f->meta->touched = true;
+				f->phase = PHASE_BEGIN;
+			}
+			break;
+
+		case PHASE_NORMALIZE:
+			if( f->self && !qs_operand_finished( (QsOperand)f->self ) ) {
+				if( !f->waiter ) {
+					f->waiter = qs_terminal_group_new( 1 );
+					qs_terminal_group_push( f->waiter,f->self );
+				}
+
+				info->blocker = f->waiter;
+				return CKS_BLOCKED_EVALUATION;
+			}
+
+			if( f->waiter ) {
+				qs_terminal_group_destroy( f->waiter );
+				f->waiter = NULL;
+			}
+
+			if( f->self ) {
+				bool is_zero = qs_coefficient_is_zero( qs_terminal_acquire( f->self ) );
+				qs_terminal_release( f->self );
 
 				if( !is_zero ) {
 					qs_pivot_graph_normalize( info->graph,i );
 
-					meta->solved = true;
-
-					return;
+					f->meta->solved = true;
+					info->n_frames--;
+					break;
 				}
 			}
 
-			DBG_PRINT( "Normalization of %i failed, forcing full solution {\n",info->rd,meta->order );
-			fprintf( stderr,"Warning: Canonical elimination in %i not normalizable (Recursion depth %i with despair %i)\n",meta->order,info->rd,despair );
-			if( despair==QS_MAX_DESPAIR ) {
+			DBG_PRINT( "Normalization of %i failed, forcing full solution\n",info->rd,f->meta->order );
+			fprintf( stderr,"Warning: Canonical elimination in %i not normalizable (Recursion depth %i with despair %i)\n",f->meta->order,info->rd,f->despair );
+			if( f->despair==QS_MAX_DESPAIR ) {
 				fprintf( stderr,"Error: Recursion for desperate elimination reached limit\n" );
 				abort( );
 			}
-			cks( info,i,despair + 1 );
-			DBG_PRINT( "}\n",info->rd );
+
+			f->despair++;
+			f->phase = PHASE_BEGIN;
+			break;
 		}
 	}
+
+	return CKS_DONE;
 }
 
-void cks_solve( struct CKSInfo* info,QsComponent i ) {
+/** Wait for what a solve is blocked on
+ *
+ * Other frontends proceed meanwhile. Waiting for an owner leaves the
+ * awaited pivot owned, which the continued solve takes over. A frontend
+ * which interleaves several solves must not wait for a pivot owned by
+ * another of its solves. Since a solve blocked on an owner owns no
+ * pivot, it can always wait for the evaluations of one of them instead.
+ *
+ * @param This
+ * @param The status returned by cks_continue
+ */
+void cks_wait( struct CKSInfo* info,enum CKSStatus status ) {
+	if( status==CKS_BLOCKED_EVALUATION ) {
+		qs_pivot_graph_unlock( info->graph );
+		qs_terminal_group_wait( info->blocker );
+		qs_pivot_graph_lock( info->graph );
+	} else if( status==CKS_BLOCKED_OWNER )
+		qs_pivot_graph_own( info->graph,info->awaited,info->frontend,true );
+}
+
+/** Begin to solve for a pivot
+ *
+ * The solve is carried out by cks_continue. The info must not be in
+ * the middle of another solve, but several infos may each be in the
+ * middle of one, even within the same frontend, if their frontend
+ * numbers differ.
+ *
+ * @param This
+ * @param The pivot
+ * @return Whether there is an identity for the pivot
+ */
+bool cks_start( struct CKSInfo* info,QsComponent i ) {
+	assert( !info->n_frames );
+
 	struct QsMetadata* meta = qs_pivot_graph_meta( info->graph,i );
 	if( !meta )
-		return;
+		return false;
+
+	if( info->width>1 && !info->eager )
+		info->eager = malloc( ( info->width - 1 )*sizeof (QsComponent) );
+
+	consider( info,i,meta,1 );
+	push_frame( info,i,1,PHASE_ACQUIRE );
 
-	DBG_PRINT( "Solving for Pivot %i {\n",0,meta->order );
-	meta->consideration = 1;
-	info->rd++;
-	cks( info,i,1 );
+	return true;
+}
+
+/** Finish a solve
+ *
+ * Releases the target of a solve once cks_continue returned CKS_DONE.
+ */
+void cks_finish( struct CKSInfo* info,QsComponent i ) {
 	info->rd--;
-	meta->consideration = 0;
+	qs_pivot_graph_disown( info->graph,i );
+	consider( info,i,qs_pivot_graph_meta( info->graph,i ),-1 );
+}
+
+/** Solve for a pivot
+ *
+ * The frontend must hold the graph. Several frontends may solve
+ * concurrently, each with its own info.
+ */
+void cks_solve( struct CKSInfo* info,QsComponent i ) {
+	if( !cks_start( info,i ) )
+		return;
+
+	DBG_PRINT( "Solving for Pivot %i {\n",0,qs_pivot_graph_meta( info->graph,i )->order );
+
+	enum CKSStatus status;
+	while( ( status = cks_continue( info ) )!=CKS_DONE )
+		cks_wait( info,status );
+
+	cks_finish( info,i );
 	DBG_PRINT( "}\n",0 );
 }
+
+static void* cks_new( QsPivotGraph g,unsigned frontend,const struct PolicyOptions* options ) {
+	struct CKSInfo* result = malloc( sizeof (struct CKSInfo) );
+	*result =( struct CKSInfo ){ g,false,options->elimination,0,frontend,options->selection=='m' ? cks_score_markowitz : NULL,options->width };
+
+	return result;
+}
+
+static void cks_terminate( struct CKSInfo* info ) {
+	info->terminate = true;
+}
+
+static void cks_destroy( struct CKSInfo* info ) {
+	free( info->considered );
+	free( info->frames );
+	free( info->eager );
+	free( info );
+}
+
+const struct Policy cks_policy = {
+	"cks",
+	"Recursive elimination of the first suitable edge found numerically nonzero, in the pivot eliminated next",
+	cks_new,
+	(void(*)( void*,QsComponent ))cks_solve,
+	(void(*)( void* ))cks_terminate,
+	(void(*)( void* ))cks_destroy
+};
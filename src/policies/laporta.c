@@ -0,0 +1,241 @@
+#include "policy.h"
+
+#define LAPORTA_PREALLOC_FRAMES 16
+
+/** Ordered elimination
+ *
+ * Eliminates the heads of a pivot in ascending order, each of which is
+ * solved first by the same means. Since a solved pivot only depends on
+ * pivots of higher order, relaying it only introduces heads of higher
+ * order than the one eliminated and the pivots on the stack descend in
+ * order, such that no consideration of cycles is required. Once the
+ * target is solved, the heads of higher order are eliminated alike,
+ * which leaves it depending on masters only.
+ */
+struct LaportaFrame {
+	QsComponent i;
+	struct QsMetadata* meta;
+};
+
+struct LaportaInfo {
+	QsPivotGraph graph;
+	volatile sig_atomic_t terminate;
+	enum Elimination elimination;
+	unsigned frontend; ///< Owner of the pivots eliminated in, counting from 1
+
+	unsigned n_frames;
+	unsigned allocated_frames;
+	struct LaportaFrame* frames; ///< Pivots waiting for the one above to be solved
+};
+
+/** Whether a coefficient is zero
+ *
+ * Waits for the evaluation without holding the graph.
+ */
+static bool laporta_is_zero( struct LaportaInfo* info,QsTerminal t ) {
+	if( !qs_operand_finished( (QsOperand)t ) ) {
+		QsTerminalGroup waiter = qs_terminal_group_new( 1 );
+		qs_terminal_group_push( waiter,t );
+
+		qs_pivot_graph_unlock( info->graph );
+		qs_terminal_group_wait( waiter );
+		qs_pivot_graph_lock( info->graph );
+
+		qs_terminal_group_destroy( waiter );
+	}
+
+	bool result = qs_coefficient_is_zero( qs_terminal_acquire( t ) );
+	qs_terminal_release( t );
+
+	return result;
+}
+
+/** Own a pivot, owning nothing else meanwhile
+ *
+ * @param This
+ * @param The pivot owned so far
+ * @param The pivot to own
+ */
+static void laporta_move( struct LaportaInfo* info,QsComponent from,QsComponent to ) {
+	qs_pivot_graph_disown( info->graph,from );
+	qs_pivot_graph_own( info->graph,to,info->frontend,true );
+}
+
+/** Push an owned pivot onto the stack
+ *
+ * The metadata is looked up only now, since owning the pivot may have
+ * waited and the pivot may have been unloaded meanwhile. Being
+ * considered, it stays loaded while it is on the stack.
+ *
+ * @param This
+ * @param The pivot, owned by the frontend
+ */
+static void laporta_push( struct LaportaInfo* info,QsComponent i ) {
+	struct QsMetadata* meta = qs_pivot_graph_meta( info->graph,i );
+
+	if( info->n_frames==info->allocated_frames ) {
+		info->allocated_frames = info->allocated_frames ? 2*info->allocated_frames : LAPORTA_PREALLOC_FRAMES;
+		info->frames = realloc( info->frames,info->allocated_frames*sizeof (struct LaportaFrame) );
+	}
+
+	info->frames[ info->n_frames++ ]=( struct LaportaFrame ){ i,meta };
+	meta->consideration++;
+
+	/* Start the evaluation of all numeric coefficients at once */
+	for( unsigned j = 0; j<qs_pivot_graph_n_refs( info->graph,i ); j++ )
+		qs_pivot_graph_terminate_nth( info->graph,i,j,true );
+}
+
+/** The edge to eliminate next
+ *
+ * @param This
+ * @param The frame
+ * @param Whether heads of higher order are eliminated as well
+ * @return Index of the edge to the head of least order or -1
+ */
+static int laporta_next( struct LaportaInfo* info,struct LaportaFrame* f,bool higher ) {
+	int result = -1;
+	unsigned result_order;
+
+	for( unsigned j = 0; j<qs_pivot_graph_n_refs( info->graph,f->i ); j++ ) {
+		const QsComponent head = qs_pivot_graph_head_nth( info->graph,f->i,j );
+		/* Masters have no identity */
+		struct QsMetadata head_meta;
+		if( head==f->i || !qs_pivot_graph_peek( info->graph,head,&head_meta ) )
+			continue;
+
+		if( ( higher || head_meta.order<f->meta->order )&&( result<0 || head_meta.order<result_order ) ) {
+			result = j;
+			result_order = head_meta.order;
+		}
+	}
+
+	return result;
+}
+
+static void laporta_normalize( struct LaportaInfo* info,struct LaportaFrame* f ) {
+	const QsComponent i = f->i;
+
+	int j_self;
+	for( j_self = 0; j_self<qs_pivot_graph_n_refs( info->graph,i ); j_self++ )
+		if( qs_pivot_graph_head_nth( info->graph,i,j_self )==i )
+			break;
+
+	if( j_self==qs_pivot_graph_n_refs( info->graph,i )|| laporta_is_zero( info,qs_pivot_graph_terminate_nth( info->graph,i,j_self,true ) ) ) {
+		fprintf( stderr,"Error: Ordered elimination in %i not normalizable, use another policy\n",f->meta->order );
+		abort( );
+	}
+
+	DBG_PRINT( "Normalizing %i\n",info->n_frames,f->meta->order );
+	qs_pivot_graph_normalize( info->graph,i );
+	f->meta->solved = true;
+}
+
+/** Solve for a target
+ *
+ * The frontend must hold the graph.
+ */
+void laporta_solve( struct LaportaInfo* info,QsComponent target ) {
+	struct QsMetadata* target_meta = qs_pivot_graph_meta( info->graph,target );
+	if( !target_meta )
+		return;
+
+	DBG_PRINT( "Solving for Pivot %i {\n",0,target_meta->order );
+
+	qs_pivot_graph_own( info->graph,target,info->frontend,true );
+	laporta_push( info,target );
+
+	while( info->n_frames ) {
+		struct LaportaFrame* f = info->frames + info->n_frames - 1;
+		const QsComponent i = f->i;
+
+		const int j = info->terminate ? -1 : laporta_next( info,f,info->n_frames==1 && f->meta->solved );
+
+		if( j<0 ) {
+			if( !f->meta->solved && !info->terminate ) {
+				laporta_normalize( info,f );
+				continue;
+			}
+
+			f->meta->consideration--;
+			info->n_frames--;
+
+			if( info->n_frames ) {
+				DBG_PRINT( "}\n",info->n_frames );
+				laporta_move( info,i,info->frames[ info->n_frames - 1 ].i );
+			}
+
+			continue;
+		}
+
+		if( laporta_is_zero( info,qs_pivot_graph_terminate_nth( info->graph,i,j,true ) ) ) {
+			if( info->elimination==ELIMINATE_OPTIMISTIC ||( info->elimination==ELIMINATE_WAIT && laporta_is_zero( info,qs_pivot_graph_terminate_nth( info->graph,i,j,false ) ) ) ) {
+				DBG_PRINT_2( " Edge #%i found zero and deleted\n",info->n_frames,j );
+				qs_pivot_graph_delete_nth( info->graph,i,j,qs_pivot_graph_n_refs( info->graph,i )- 1 );
+				continue;
+			}
+
+			/* Relaying the edge is exact either way */
+			if( info->elimination==ELIMINATE_WAIT )
+				fprintf( stderr,"Warning: Numeric cancellation on edge of pivot %i\n",f->meta->order );
+		}
+
+		const QsComponent next_i = qs_pivot_graph_head_nth( info->graph,i,j );
+		struct QsMetadata* next_meta = qs_pivot_graph_meta( info->graph,next_i );
+
+		if( !next_meta->solved ) {
+			DBG_PRINT( "Eliminating %i from %i {\n",info->n_frames,next_meta->order,f->meta->order );
+
+			/* Other frontends may modify the current pivot meanwhile, which
+			 * is why the next edge is looked for anew on return */
+			laporta_move( info,i,next_i );
+			laporta_push( info,next_i );
+			continue;
+		}
+
+		/* A frontend never waits while owning another pivot */
+		if( !qs_pivot_graph_own( info->graph,next_i,info->frontend,false ) ) {
+			laporta_move( info,i,next_i );
+			laporta_move( info,next_i,i );
+			continue;
+		}
+
+		DBG_PRINT_2( " Relaying %i into %i\n",info->n_frames,next_meta->order,f->meta->order );
+		qs_pivot_graph_relay_collect( info->graph,i,next_i );
+		qs_pivot_graph_disown( info->graph,next_i );
+
+		/* A solved head only refers to pivots of higher order, which
+		 * leaves a pivot of lower order normalized and solved */
+		if( next_meta->order<f->meta->order )
+			f->meta->solved = false;
+		f->meta->touched = true;
+	}
+
+	qs_pivot_graph_disown( info->graph,target );
+	DBG_PRINT( "}\n",0 );
+}
+
+static void* laporta_new( QsPivotGraph g,unsigned frontend,const struct PolicyOptions* options ) {
+	struct LaportaInfo* result = malloc( sizeof (struct LaportaInfo) );
+	*result =( struct LaportaInfo ){ g,false,options->elimination,frontend,0,0,NULL };
+
+	return result;
+}
+
+static void laporta_terminate( struct LaportaInfo* info ) {
+	info->terminate = true;
+}
+
+static void laporta_destroy( struct LaportaInfo* info ) {
+	free( info->frames );
+	free( info );
+}
+
+const struct Policy laporta_policy = {
+	"laporta",
+	"Ordered elimination of all heads of lower order than the pivot, in ascending order, followed by those of higher order in the target",
+	laporta_new,
+	(void(*)( void*,QsComponent ))laporta_solve,
+	(void(*)( void* ))laporta_terminate,
+	(void(*)( void* ))laporta_destroy
+};
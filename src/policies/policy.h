@@ -0,0 +1,63 @@
+#ifndef _QS_POLICY_H_
+#define _QS_POLICY_H_
+
+#include <stdbool.h>
+
+#include "../pivotgraph.h"
+
+enum Elimination {
+	ELIMINATE_WAIT,
+	ELIMINATE_OPTIMISTIC,
+	ELIMINATE_NONE
+};
+
+/** Settings of the elimination common to all policies
+ */
+struct PolicyOptions {
+	enum Elimination elimination; ///< How to deal with numerical zeroes
+	char selection; ///< Which edge found ready to eliminate first, if the policy chooses
+	unsigned width; ///< How many edges found ready to relay at once, if the policy chooses
+};
+
+/** Elimination policy
+ *
+ * Each frontend solves with a state of its own, created for the owner
+ * number of the frontend, counting from 1. Frontends solve concurrently
+ * and must only own the pivot they eliminate in while they wait.
+ *
+ * There are no separate hooks to begin or finish a target. Whatever a
+ * policy sets up for a target is done and undone within the solve,
+ * which returns with the target disowned, such that the frontend can
+ * hand the solution over right away. Neither policy needs more, and
+ * cks_start, cks_continue and cks_finish, which interleave targets, are
+ * only used by calling cks directly.
+ */
+struct Policy {
+	const char* name;
+	const char* description;
+
+	/** Create the state of a frontend
+	 *
+	 * @param Graph
+	 * @param Owner number of the frontend
+	 * @param Options
+	 */
+	void*(* new )( QsPivotGraph,unsigned,const struct PolicyOptions* );
+
+	/** Solve for a target
+	 *
+	 * The frontend holds the graph. Once the solve returns, the target
+	 * is expressed in terms of masters, unless termination was requested.
+	 */
+	void(* solve )( void*,QsComponent );
+
+	/** Request termination
+	 *
+	 * Invoked from a signal handler, the solve in progress returns as
+	 * soon as possible.
+	 */
+	void(* terminate )( void* );
+	void(* destroy )( void* );
+};
+
+#endif
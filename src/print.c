@@ -2,12 +2,33 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define PRINT_BUFFER_FLUSH ( 1<<16 )
+#define PRINT_BUFFER_MEMORY 1024
 
 struct QsPrint {
 	size_t n_prints;
 	char** printspaces;
 };
 
+/** Reusable output buffer
+ *
+ * Output is formatted into a growable buffer by reserving space,
+ * writing into it directly and committing the number of written bytes.
+ * The buffer is written to its file descriptor once it holds more than
+ * PRINT_BUFFER_FLUSH bytes and on explicit flush. The memory is kept
+ * for subsequent output. A buffer without file descriptor holds its
+ * output until it is appended to another one.
+ */
+struct QsPrintBuffer {
+	int fd;
+	size_t size;
+	size_t allocated;
+	char* data;
+};
+
 QsPrint qs_print_new( ) {
 	QsPrint res = malloc( sizeof (struct QsPrint) );
 	res->n_prints = 0;
@@ -34,3 +55,79 @@ void qs_print_destroy( QsPrint p ) {
 	free( p->printspaces );
 	free( p );
 }
+
+QsPrintBuffer qs_print_buffer_new( int fd ) {
+	QsPrintBuffer result = malloc( sizeof (struct QsPrintBuffer) );
+	result->fd = fd;
+	result->size = 0;
+	result->allocated = fd<0?PRINT_BUFFER_MEMORY:2*PRINT_BUFFER_FLUSH;
+	result->data = malloc( result->allocated );
+
+	return result;
+}
+
+/** Reserve space for output
+ *
+ * @param This
+ * @param Number of bytes to reserve
+ * @return Memory for at least the reserved number of bytes, valid until
+ * the next call on the buffer
+ */
+char* qs_print_buffer_reserve( QsPrintBuffer b,size_t n ) {
+	if( b->allocated - b->size<n ) {
+		while( b->allocated - b->size<n )
+			b->allocated *= 2;
+
+		b->data = realloc( b->data,b->allocated );
+	}
+
+	return b->data + b->size;
+}
+
+/** Commit output
+ *
+ * @param This
+ * @param Number of bytes written into the reserved memory
+ */
+void qs_print_buffer_commit( QsPrintBuffer b,size_t n ) {
+	b->size += n;
+
+	if( b->fd>=0 && b->size>PRINT_BUFFER_FLUSH )
+		qs_print_buffer_flush( b );
+}
+
+void qs_print_buffer_append( QsPrintBuffer b,const char* data,size_t n ) {
+	memcpy( qs_print_buffer_reserve( b,n ),data,n );
+	qs_print_buffer_commit( b,n );
+}
+
+/** Append the output of another buffer
+ *
+ * @param This
+ * @param Buffer whose output is moved
+ */
+void qs_print_buffer_transfer( QsPrintBuffer b,QsPrintBuffer from ) {
+	qs_print_buffer_append( b,from->data,from->size );
+	from->size = 0;
+}
+
+void qs_print_buffer_flush( QsPrintBuffer b ) {
+	size_t written = 0;
+
+	while( written<b->size ) {
+		ssize_t got = write( b->fd,b->data + written,b->size - written );
+
+		if( got<0 && errno!=EINTR )
+			break;
+		else if( got>0 )
+			written += got;
+	}
+
+	b->size = 0;
+}
+
+void qs_print_buffer_destroy( QsPrintBuffer b ) {
+	qs_print_buffer_flush( b );
+	free( b->data );
+	free( b );
+}
@@ -1,6 +1,17 @@
+#include <stddef.h>
+
 typedef unsigned(* QsPrintFunction)( const void*,char** );
 typedef struct QsPrint* QsPrint;
+typedef struct QsPrintBuffer* QsPrintBuffer;
 
 QsPrint qs_print_new( );
 char* qs_print_generic_to_string( QsPrint,const void*,QsPrintFunction );
 void qs_print_destroy( QsPrint );
+
+QsPrintBuffer qs_print_buffer_new( int );
+char* qs_print_buffer_reserve( QsPrintBuffer,size_t );
+void qs_print_buffer_commit( QsPrintBuffer,size_t );
+void qs_print_buffer_append( QsPrintBuffer,const char*,size_t );
+void qs_print_buffer_transfer( QsPrintBuffer,QsPrintBuffer );
+void qs_print_buffer_flush( QsPrintBuffer );
+void qs_print_buffer_destroy( QsPrintBuffer );
@@ -41,6 +41,179 @@ void push( struct OperandPool* p,struct Operand o ) {
 	p->n_operands++;
 }
 
+static unsigned n_failed = 0;
+
+static void check( bool passed,const char* what ) {
+	printf( "%s: %s\n",what,passed ? "passed" : "FAILED" );
+
+	if( !passed )
+		n_failed++;
+}
+
+/** Pop a finished terminal and compare its tag against the expectation
+ *
+ * @param Group
+ * @param Terminals pushed, indexed by their original tag
+ * @param Expected tag for each of the terminals
+ * @param Number of terminals
+ * @return Whether a terminal was popped with the expected tag
+ */
+static bool pop_expected( QsTerminalGroup g,QsTerminal* terminals,const unsigned* tags,unsigned n ) {
+	unsigned tag;
+	QsTerminal t = qs_terminal_group_pop_tagged( g,&tag );
+
+	int j;
+	for( j = 0; j<n; j++ )
+		if( t==terminals[ j ] )
+			return tag==tags[ j ];
+
+	return false;
+}
+
+/** Test tagging in QsTerminalGroup
+ *
+ * Finished terminals are popped right away, so nothing is evaluated.
+ */
+static void test_group_tags( ) {
+	printf( "Testing tags of QsTerminalGroup...\n" );
+
+	QsTerminal terminals[ 4 ];
+	int j;
+	for( j = 0; j<4; j++ ) {
+		terminals[ j ]= qs_operand_new( NULL,NULL );
+		qs_terminal_load( terminals[ j ],qs_coefficient_new_from_binary( "1",1 ) );
+	}
+
+	QsTerminalGroup g = qs_terminal_group_new( 1 );
+	for( j = 0; j<4; j++ )
+		qs_terminal_group_push_tagged( g,terminals[ j ],j );
+
+	/* The first target is popped and the last one takes its place */
+	check( pop_expected( g,terminals,(unsigned[ ]){ 0,1,2,3 },4 ),"pop first" );
+	check( qs_terminal_group_count( g )==3,"count after pop" );
+
+	qs_terminal_group_retag( g,3,7 );
+	qs_terminal_group_retag( g,0,9 );
+	qs_terminal_group_retag( g,1,0 );
+
+	check( pop_expected( g,terminals,(unsigned[ ]){ 0,0,2,7 },4 ),"pop retagged moved" );
+	check( pop_expected( g,terminals,(unsigned[ ]){ 0,0,2,7 },4 ),"pop retagged" );
+	check( pop_expected( g,terminals,(unsigned[ ]){ 0,0,2,7 },4 ),"pop untouched" );
+	check( !qs_terminal_group_pop_tagged( g,NULL ),"pop empty" );
+
+	/* Stale tags from before clearing are not found */
+	qs_terminal_group_push_tagged( g,terminals[ 0 ],2 );
+	qs_terminal_group_push_tagged( g,terminals[ 1 ],100 );
+	qs_terminal_group_clear( g );
+	qs_terminal_group_push_tagged( g,terminals[ 2 ],5 );
+	qs_terminal_group_retag( g,100,6 );
+	qs_terminal_group_retag( g,2,6 );
+	check( pop_expected( g,terminals,(unsigned[ ]){ 0,0,5,0 },4 ),"pop after clear" );
+
+	qs_terminal_group_destroy( g );
+
+	for( j = 0; j<4; j++ )
+		qs_operand_unref( (QsOperand)terminals[ j ] );
+}
+
+/** Terminals sharing pending evaluations
+ */
+struct Sharing {
+	QsTerminal operands[ 2 ];
+	QsTerminal sum; ///< Baked twice
+	QsTerminal others[ 3 ]; ///< Differing from the sum in the operation, the order of operands or an intermediate
+	QsTerminal linked; ///< Baked twice from identical intermediates
+	QsTerminal difference; ///< Baked three times, discarded twice
+	QsTerminalGroup waiters[ 2 ]; ///< Both waiting for the sum
+};
+
+/** Bake identical expressions before any evaluation
+ *
+ * @param AEF without workers yet
+ * @param[out] Terminals to be checked by test_sharing_finish once
+ * workers are spawned
+ */
+static void test_sharing_start( QsAEF aef,struct Sharing* s ) {
+	printf( "Testing hash-consing of pending QsTerminals...\n" );
+
+	const char* operand_strings[ ]= { "x","23" };
+
+	int j;
+	for( j = 0; j<2; j++ ) {
+		s->operands[ j ]= qs_operand_new( NULL,NULL );
+		qs_terminal_load( s->operands[ j ],qs_coefficient_new_from_binary( operand_strings[ j ],strlen( operand_strings[ j ] ) ) );
+	}
+
+	QsOperand* os = (QsOperand*)s->operands;
+	QsOperand swapped[ ]= { os[ 1 ],os[ 0 ] };
+
+	s->sum = qs_operand_bake( 2,os,QS_OPERATION_ADD,aef,NULL,NULL );
+	check( qs_operand_bake( 2,os,QS_OPERATION_ADD,aef,NULL,NULL )==s->sum,"identical bake shared" );
+	check( qs_operand_shared( (QsOperand)s->sum ),"identical bake referenced" );
+
+	s->others[ 0 ]= qs_operand_bake( 2,os,QS_OPERATION_MUL,aef,NULL,NULL );
+	s->others[ 1 ]= qs_operand_bake( 2,swapped,QS_OPERATION_ADD,aef,NULL,NULL );
+
+	QsIntermediate link = qs_operand_link( 2,os,QS_OPERATION_ADD );
+	s->others[ 2 ]= qs_operand_bake( 1,(QsOperand[ ]){ (QsOperand)link },QS_OPERATION_ADD,aef,NULL,NULL );
+	qs_operand_unref( (QsOperand)link );
+
+	for( j = 0; j<3; j++ )
+		check( s->others[ j ]!=s->sum,"differing bake not shared" );
+
+	/* Intermediates are compared by their expressions */
+	for( j = 0; j<2; j++ ) {
+		QsIntermediate link = qs_operand_link( 2,os,QS_OPERATION_MUL );
+		QsTerminal linked = qs_operand_bake( 2,(QsOperand[ ]){ (QsOperand)link,os[ 0 ] },QS_OPERATION_SUB,aef,NULL,NULL );
+		qs_operand_unref( (QsOperand)link );
+
+		if( j )
+			check( linked==s->linked,"bake of identical intermediates shared" );
+		else
+			s->linked = linked;
+	}
+
+	/* Both discards are references of their own, the last one is kept */
+	s->difference = qs_operand_bake( 2,os,QS_OPERATION_SUB,aef,NULL,NULL );
+	for( j = 0; j<2; j++ )
+		qs_operand_discard( qs_operand_bake( 2,os,QS_OPERATION_SUB,aef,NULL,NULL ),false );
+
+	for( j = 0; j<2; j++ ) {
+		s->waiters[ j ]= qs_terminal_group_new( 1 );
+		qs_terminal_group_push( s->waiters[ j ],s->sum );
+	}
+}
+
+/** Wait for the terminals shared before any evaluation
+ *
+ * @param Terminals of test_sharing_start, released
+ */
+static void test_sharing_finish( struct Sharing* s ) {
+	int j;
+	for( j = 0; j<2; j++ ) {
+		qs_terminal_group_wait( s->waiters[ j ] );
+		check( qs_terminal_group_pop( s->waiters[ j ] )==s->sum,"each waiter of a shared QsTerminal woken" );
+		qs_terminal_group_destroy( s->waiters[ j ] );
+	}
+
+	/* Discarding references the worker drops once evaluated */
+	qs_terminal_wait( s->difference );
+	check( !qs_operand_shared( (QsOperand)s->difference ),"repeated discards released" );
+	qs_operand_unref( (QsOperand)s->difference );
+
+	for( j = 0; j<2; j++ )
+		qs_operand_unref( (QsOperand)s->sum );
+
+	for( j = 0; j<2; j++ )
+		qs_operand_unref( (QsOperand)qs_terminal_wait( s->linked ) );
+
+	for( j = 0; j<3; j++ )
+		qs_operand_unref( (QsOperand)qs_terminal_wait( s->others[ j ] ) );
+
+	for( j = 0; j<2; j++ )
+		qs_operand_unref( (QsOperand)s->operands[ j ] );
+}
+
 int main( int argv,char* argc[ ] ) {
 	printf( "Testing QsOperand, QsAEF, QsTerminal, QsCoefficient and QsIntermediate\n" );
 
@@ -59,6 +232,8 @@ int main( int argv,char* argc[ ] ) {
 		"5/x/ep^3"
 	};
 
+	test_group_tags( );
+
 	srand( 100 );
 
 	unsigned p_terminal = 100;
@@ -88,6 +263,9 @@ int main( int argv,char* argc[ ] ) {
 	QsAEF aef = qs_aef_new( 0 );
 #endif
 
+	struct Sharing sharing;
+	test_sharing_start( aef,&sharing );
+
 	printf( "Creating original QsCoefficients...\n" );
 	unsigned name = 0;
 	for( j = 0; j<n_coeffs; j++ ) {
@@ -174,6 +352,8 @@ int main( int argv,char* argc[ ] ) {
 
 	qs_evaluator_options_destroy( opts );
 
+	test_sharing_finish( &sharing );
+
 	printf( "Waiting for terminals...\n" );
 	while( terminals.n_operands ) {
 		struct Operand target = pop_rand( &terminals );
@@ -193,5 +373,7 @@ int main( int argv,char* argc[ ] ) {
 
 	qs_aef_destroy( aef );
 
-	return EXIT_SUCCESS;
+	printf( "%u failed\n",n_failed );
+
+	return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
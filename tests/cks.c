@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/pivotgraph.h"
+#include "../src/policies/cks.c"
+
+#define N_IDENTITIES 60
+#define N_MASTERS 4
+#define N_HEADS 4
+#define N_INTERLEAVED 3
+
+static unsigned n_failed = 0;
+
+static void check( bool passed,const char* what ) {
+	printf( "%s: %s\n",what,passed ? "passed" : "FAILED" );
+
+	if( !passed )
+		n_failed++;
+}
+
+static unsigned long next_random( unsigned long* state ) {
+	*state = *state*6364136223846793005UL + 1442695040888963407UL;
+	return *state>>33;
+}
+
+/** Identity of a system of numeric coefficients
+ *
+ * Each identity references itself and a few other identities, mostly
+ * of lower order, or masters, which are numbered after the identities.
+ */
+static struct QsReflist load( void* data,QsComponent i,struct QsMetadata* meta ) {
+	struct QsReflist result = { 0,NULL };
+	if( i>=N_IDENTITIES )
+		return result;
+
+	unsigned long state = i*7919 + 17;
+
+	result.references = malloc( ( N_HEADS + 1 )*sizeof (struct QsReference) );
+	result.references[ result.n_references++ ]=( struct QsReference ){ i,qs_coefficient_one( true ) };
+
+	int j;
+	for( j = 0; j<N_HEADS; j++ ) {
+		const QsComponent head = next_random( &state )%( N_IDENTITIES + N_MASTERS );
+
+		bool skip = head>i && head<N_IDENTITIES && next_random( &state )%4;
+		int k;
+		for( k = 0; k<result.n_references; k++ )
+			skip = skip || result.references[ k ].head==head;
+
+		if( skip )
+			continue;
+
+		char* text = malloc( 16 );
+		long numerator = (long)( next_random( &state )%19 )- 9;
+		snprintf( text,16,"%ld/%lu",numerator ? numerator : 1,next_random( &state )%7 + 1 );
+
+		result.references[ result.n_references++ ]=( struct QsReference ){ head,qs_coefficient_new_with_string( text ) };
+	}
+
+	*meta =( struct QsMetadata ){ i + 1,0,false,false };
+
+	return result;
+}
+
+/** Discard pivots on destruction of the graph
+ */
+static void save( void* data,QsComponent i,struct QsReflist l,struct QsMetadata meta ) {
+}
+
+static QsPivotGraph graph_new( QsAEF* aefs ) {
+	QsEvaluatorOptions options = qs_evaluator_options_new( );
+	qs_evaluator_options_add( options,"!",FERMAT_BINARY );
+	qs_evaluator_options_add( options,"@",true );
+
+	int j;
+	for( j = 0; j<2; j++ ) {
+#if QS_STATUS
+		aefs[ j ]= qs_aef_new( 0,j==1 );
+#else
+		aefs[ j ]= qs_aef_new( 0 );
+#endif
+		qs_aef_spawn( aefs[ j ],options );
+		qs_aef_spawn( aefs[ j ],options );
+	}
+
+	qs_evaluator_options_destroy( options );
+
+	return qs_pivot_graph_new_with_size( aefs[ 0 ],aefs[ 1 ],NULL,load,NULL,NULL,NULL,save,NULL,0,N_IDENTITIES + N_MASTERS );
+}
+
+static void graph_destroy( QsPivotGraph g,QsAEF* aefs ) {
+	qs_pivot_graph_destroy( g );
+	qs_aef_destroy( aefs[ 0 ] );
+	qs_aef_destroy( aefs[ 1 ] );
+}
+
+/** Solve for every identity, interleaving several solves in this thread
+ *
+ * Whenever no solve is done, waits for what one of them is blocked on,
+ * preferably evaluations, as cks_wait requires.
+ *
+ * @return Number of times a solve returned to let another one continue
+ */
+static unsigned solve_interleaved( QsPivotGraph g,struct CKSInfo** infos ) {
+	QsComponent targets[ N_INTERLEAVED ];
+	bool busy[ N_INTERLEAVED ]= { false };
+	QsComponent next = 0;
+	unsigned n_yields = 0;
+
+	while( true ) {
+		unsigned n_busy = 0;
+		bool done = false;
+		int blocked = -1;
+		enum CKSStatus blocked_status;
+
+		int k;
+		for( k = 0; k<N_INTERLEAVED; k++ ) {
+			while( !busy[ k ]&& next<N_IDENTITIES ) {
+				targets[ k ]= next++;
+				busy[ k ]= cks_start( infos[ k ],targets[ k ] );
+			}
+
+			if( !busy[ k ] )
+				continue;
+
+			n_busy++;
+
+			const enum CKSStatus status = cks_continue( infos[ k ] );
+			if( status==CKS_DONE ) {
+				cks_finish( infos[ k ],targets[ k ] );
+				busy[ k ]= false;
+				done = true;
+			} else {
+				n_yields++;
+
+				if( blocked<0 || status==CKS_BLOCKED_EVALUATION ) {
+					blocked = k;
+					blocked_status = status;
+				}
+			}
+		}
+
+		if( !n_busy )
+			break;
+
+		if( !done )
+			cks_wait( infos[ blocked ],blocked_status );
+	}
+
+	return n_yields;
+}
+
+/** Coefficient of a head in a solution
+ *
+ * @return The printed coefficient or NULL if there is no reference to the head
+ */
+static char* coefficient_of( struct QsReflist l,QsComponent head ) {
+	int j;
+	for( j = 0; j<l.n_references; j++ )
+		if( l.references[ j ].head==head ) {
+			char* result;
+			qs_coefficient_print( l.references[ j ].coefficient,&result );
+
+			return result;
+		}
+
+	return NULL;
+}
+
+/** Compare the solution for an identity between two graphs
+ *
+ * @return Whether the solutions depend on masters only and agree
+ */
+static bool solutions_agree( QsPivotGraph a,QsPivotGraph b,QsComponent i ) {
+	qs_pivot_graph_meta( a,i );
+	qs_pivot_graph_meta( b,i );
+	struct QsReflist la = qs_pivot_graph_acquire( a,i );
+	struct QsReflist lb = qs_pivot_graph_acquire( b,i );
+
+	bool result = true;
+
+	int j;
+	for( j = 0; j<la.n_references; j++ )
+		result = result &&( la.references[ j ].head==i || la.references[ j ].head>=N_IDENTITIES );
+
+	QsComponent head;
+	for( head = i; head<N_IDENTITIES + N_MASTERS; head = head==i ? N_IDENTITIES : head + 1 ) {
+		char* ca = coefficient_of( la,head );
+		char* cb = coefficient_of( lb,head );
+
+		/* An edge eliminated to zero may or may not remain */
+		result = result && !strcmp( ca ? ca : "0",cb ? cb : "0" );
+
+		free( ca );
+		free( cb );
+	}
+
+	qs_pivot_graph_release( a,i );
+	qs_pivot_graph_release( b,i );
+	free( la.references );
+	free( lb.references );
+
+	return result;
+}
+
+int main( int argc,char* argv[ ] ) {
+	printf( "Testing interleaved solves of the cks policy\n" );
+
+	const struct PolicyOptions options = { ELIMINATE_WAIT,'f',1 };
+
+	QsAEF interleaved_aefs[ 2 ];
+	QsPivotGraph interleaved = graph_new( interleaved_aefs );
+
+	struct CKSInfo* infos[ N_INTERLEAVED ];
+	int k;
+	for( k = 0; k<N_INTERLEAVED; k++ )
+		infos[ k ]= cks_policy.new( interleaved,k + 1,&options );
+
+	qs_pivot_graph_lock( interleaved );
+	check( solve_interleaved( interleaved,infos ),"solves interleaved" );
+	qs_pivot_graph_unlock( interleaved );
+
+	for( k = 0; k<N_INTERLEAVED; k++ )
+		cks_policy.destroy( infos[ k ] );
+
+	QsAEF sequential_aefs[ 2 ];
+	QsPivotGraph sequential = graph_new( sequential_aefs );
+	struct CKSInfo* info = cks_policy.new( sequential,1,&options );
+
+	qs_pivot_graph_lock( sequential );
+	QsComponent i;
+	for( i = 0; i<N_IDENTITIES; i++ )
+		cks_solve( info,i );
+	qs_pivot_graph_unlock( sequential );
+
+	cks_policy.destroy( info );
+
+	bool agree = true;
+	for( i = 0; i<N_IDENTITIES; i++ )
+		agree = agree && solutions_agree( interleaved,sequential,i );
+
+	check( agree,"interleaved solutions agree with sequential ones" );
+
+	graph_destroy( interleaved,interleaved_aefs );
+	graph_destroy( sequential,sequential_aefs );
+
+	printf( "%u failed\n",n_failed );
+
+	return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/coefficient.h"
+
+static unsigned n_failed = 0;
+
+/** Substitute in a text and compare against the expectation
+ *
+ * @param Substitution set
+ * @param Text of the coefficient
+ * @param Expected text after substitution
+ */
+static void check( QsSubstitution s,const char* text,const char* expected ) {
+	QsCoefficient c = qs_coefficient_new_from_binary( text,strlen( text ) );
+	qs_coefficient_substitute( c,s );
+
+	char* result = qs_coefficient_disband( c );
+	bool passed = !strcmp( result,expected );
+
+	printf( "\"%s\" -> \"%s\": %s\n",text,result,passed ? "passed" : "FAILED" );
+
+	if( !passed )
+		n_failed++;
+
+	free( result );
+}
+
+int main( int argc,char* argv[ ] ) {
+	printf( "Testing qs_coefficient_substitute\n" );
+
+	QsSubstitution s = qs_substitution_new( );
+	check( s,"x+y",    "x+y" );
+
+	qs_substitution_add( s,"x","1" );
+	qs_substitution_add( s,"x2","2" );
+	qs_substitution_add( s,"y","x" );
+	qs_substitution_add( s,"ab","3" );
+	qs_substitution_add( s,"bc","4" );
+	qs_substitution_add( s,"y","5" );
+
+	/* No occurrences */
+	check( s,"",       "" );
+	check( s,"z^2-1",  "z^2-1" );
+
+	/* Adjacent occurrences */
+	check( s,"xx",     "(1)(1)" );
+	check( s,"x*x+x",  "(1)*(1)+(1)" );
+	check( s,"abbc",   "(3)(4)" );
+
+	/* Symbols contained in one another, the longest one is replaced */
+	check( s,"x2",     "(2)" );
+	check( s,"x2x",    "(2)(1)" );
+	check( s,"x^2*x2", "(1)^2*(2)" );
+
+	/* Overlapping occurrences, the leftmost one is replaced */
+	check( s,"abc",    "(3)c" );
+	check( s,"aabcc",  "a(3)cc" );
+	check( s,"bcab",   "(4)(3)" );
+
+	/* The first substitution of a symbol takes precedence and values are
+	 * not substituted in turn */
+	check( s,"y",      "(x)" );
+	check( s,"x*y",    "(1)*(x)" );
+
+	qs_substitution_destroy( s );
+
+	printf( "%u failed\n",n_failed );
+
+	return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "../src/integral.h"
+
+#define MAX_POWERS 8
+
+static unsigned n_failed = 0;
+
+/** Parse a string and compare against the expectation
+ *
+ * @param String
+ * @param Whether the string is expected to be valid
+ * @param Expected prototype
+ * @param Expected number of powers
+ * @param Expected powers
+ */
+static void check( const char* s,bool valid,QsPrototype prototype,unsigned n_powers,const long* powers ) {
+	QsPrototype result_prototype;
+	unsigned result_n_powers;
+	QsPower result_powers[ MAX_POWERS ];
+
+	bool result = qs_integral_parse( s,s + strlen( s ),&result_prototype,&result_n_powers,result_powers );
+
+	bool passed = result==valid;
+	if( passed && valid ) {
+		passed = result_prototype==prototype && result_n_powers==n_powers;
+
+		int j;
+		for( j = 0; passed && j<n_powers; j++ )
+			passed = result_powers[ j ]==powers[ j ];
+	}
+
+	printf( "\"%s\": %s\n",s,passed ? "passed" : "FAILED" );
+
+	if( !passed )
+		n_failed++;
+}
+
+int main( int argc,char* argv[ ] ) {
+	printf( "Testing qs_integral_parse\n" );
+
+	check( "PR12(1,-2,0)",true,12,3,(long[ ]){ 1,-2,0 } );
+	check( " PR3(+4)\r",true,3,1,(long[ ]){ 4 } );
+	check( "PR1()",true,1,0,NULL );
+	check( "PR0x1f(0x10,010,-0x7,0)",true,31,4,(long[ ]){ 16,8,-7,0 } );
+	check( "PR010(07)",true,8,1,(long[ ]){ 7 } );
+	check( "PR2( 1 , -3,\t4 )",true,2,3,(long[ ]){ 1,-3,4 } );
+	check( "PR2( )",true,2,0,NULL );
+	check( "PR2 (5)",true,2,1,(long[ ]){ 5 } );
+
+	check( "PR(1)",false,0,0,NULL );
+	check( "XR1(1)",false,0,0,NULL );
+	check( "PR1(1",false,0,0,NULL );
+	check( "PR1(1,)",false,0,0,NULL );
+	check( "PR1(1,,2)",false,0,0,NULL );
+	check( "PR1(-)",false,0,0,NULL );
+	check( "PR1(- 1)",false,0,0,NULL );
+	check( "P R1(1)",false,0,0,NULL );
+	check( "PR1(0x)",false,0,0,NULL );
+	check( "PR1(08)",false,0,0,NULL );
+	check( "PR99999999999999999999(1)",false,0,0,NULL );
+	check( "PR1(99999999999999999999999999999999)",false,0,0,NULL );
+
+	/* Limits of the power type */
+	const unsigned long power_max =( 1UL<<( CHAR_BIT*sizeof (QsPower) - 1 ) )- 1;
+	char s[ 64 ];
+
+	snprintf( s,sizeof s,"PR1(%lu,-%lu)",power_max,power_max + 1 );
+	check( s,true,1,2,(long[ ]){ power_max,-(long)( power_max - 1 )- 2 } );
+
+	snprintf( s,sizeof s,"PR1(%lu)",power_max + 1 );
+	check( s,false,0,0,NULL );
+
+	snprintf( s,sizeof s,"PR1(-%lu)",power_max + 2 );
+	check( s,false,0,0,NULL );
+
+	printf( "%u failed\n",n_failed );
+
+	return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}